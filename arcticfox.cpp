@@ -1,4 +1,6 @@
 #include <iostream>
+#include <sstream>
+#include <string>
 #include "modules/log.cpp"
 #include "uci.cpp"
 
@@ -16,6 +18,8 @@
  *    Print this help message.
  *  -v, --version
  *    Print version information.
+ *  bench [depth] [threads] [hash]
+ *    Search the benchmark positions and print the nodes and speed.
  * 
 ***********************************************************************/
 
@@ -30,6 +34,14 @@ int main(int argc, char *argv[]) {
       std::cout << "Usage: " << argv[0] << " [options]\n";
       std::cout << "  -h --help   \n\tPrint this help message.\n";
       std::cout << "  -v --version\n\tPrint version information.\n";
+      std::cout << "  bench [depth] [threads] [hash]\n\tSearch the benchmark positions and print the nodes and speed.\n";
+      return 0;
+    } else if (arg == "bench") {
+      std::string arguments;
+      for (int j = i + 1; j < argc; j++)
+        arguments += std::string(argv[j]) + " ";
+      std::istringstream string_stream(arguments);
+      bench(string_stream);
       return 0;
     } else {
       std::cout << "Unknown option: " << arg << "\n";
@@ -4,6 +4,7 @@
 #include "base.cpp"
 #include "board.cpp"
 #include "magic.cpp"
+#include "pext.cpp"
 
 /***********************************************************************
  * 
@@ -94,6 +95,30 @@ constexpr std::array<bitboard_t, 64> _generate_king_attack() {
 };
 constexpr std::array<bitboard_t, 64> king_attack = _generate_king_attack();
 
+// look up the attacks of a bishop in the pext or the magic table
+inline bitboard_t _bishop_attack(square_t square, bitboard_t occupancy) {
+#ifdef USE_PEXT
+  return pext_table[bishop_pexts[square].offset + _pext_u64(occupancy, bishop_pexts[square].mask)];
+#else
+  return magic_table[
+    bishop_magics[square].offset +
+    (((occupancy | bishop_magics[square].mask) * bishop_magics[square].magic_number) >> 55)
+  ];
+#endif
+};
+
+// look up the attacks of a rook in the pext or the magic table
+inline bitboard_t _rook_attack(square_t square, bitboard_t occupancy) {
+#ifdef USE_PEXT
+  return pext_table[rook_pexts[square].offset + _pext_u64(occupancy, rook_pexts[square].mask)];
+#else
+  return magic_table[
+    rook_magics[square].offset +
+    (((occupancy | rook_magics[square].mask) * rook_magics[square].magic_number) >> 52)
+  ];
+#endif
+};
+
 // access to all the piece attack tables
 template <piece_t piece>
 bitboard_t attack(square_t square, bitboard_t occupancy=none) {
@@ -104,26 +129,11 @@ bitboard_t attack(square_t square, bitboard_t occupancy=none) {
   } else if constexpr (piece_type(piece) == knight) {
     return knight_attack[square];
   } else if constexpr (piece_type(piece) == bishop) {
-    return magic_table[
-      bishop_magics[square].offset +
-      (((occupancy | bishop_magics[square].mask) * bishop_magics[square].magic_number) >> 55)
-    ];
+    return _bishop_attack(square, occupancy);
   } else if constexpr (piece_type(piece) == rook) {
-    return magic_table[
-      rook_magics[square].offset +
-      (((occupancy | rook_magics[square].mask) * rook_magics[square].magic_number) >> 52)
-    ];
+    return _rook_attack(square, occupancy);
   } else if constexpr (piece_type(piece) == queen) {
-    return (
-      magic_table[
-        bishop_magics[square].offset +
-        (((occupancy | bishop_magics[square].mask) * bishop_magics[square].magic_number) >> 55)
-      ] |
-      magic_table[
-        rook_magics[square].offset +
-        (((occupancy | rook_magics[square].mask) * rook_magics[square].magic_number) >> 52)
-      ]
-    );
+    return _bishop_attack(square, occupancy) | _rook_attack(square, occupancy);
   } else if constexpr (piece_type(piece) == king) {
     return king_attack[square];
   } else {
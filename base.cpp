@@ -13,6 +13,11 @@
 #define MAX_MOVE_GENERATION_SIZE 512
 #define MAX_PV_DEPTH 32
 #define MAX_QSEARCH_DEPTH 32
+#define MAX_THREADS 256
+#define DEFAULT_HASH_SIZE 64
+#define MAX_HASH_SIZE 65536
+#define DEFAULT_EVAL_CACHE_SIZE 0
+#define MAX_EVAL_CACHE_SIZE 4096
 #define ZOBRIST_SEED 0
 #define LOG_FILE "arcticfox.log"
 #define ASCII_ART "                        ▒  ▒▒▒                              \n"\
@@ -62,6 +67,7 @@ typedef u64_t hash_t;
 typedef u32_t move_t;
 typedef u8_t movetype_t;
 typedef u8_t outcome_t;
+typedef i32_t packed_score_t;
 typedef u8_t piece_t;
 typedef i16_t score_t;
 typedef u8_t square_t;
@@ -71,6 +77,12 @@ typedef u8_t square_t;
 
 #define none 0ULL
 
+// index the sliding attacks with pext where bmi2 is available, building
+// with -DNO_PEXT keeps the magics for cpus with a slow microcoded pext
+#if defined(__BMI2__) && !defined(NO_PEXT)
+#define USE_PEXT
+#endif
+
 
 // macros
 
@@ -367,12 +379,6 @@ struct {
   };
 } comparison;
 
-struct {
-  bool operator()(move_t move1, move_t move2) const {
-    return mvv_lva_key(move1) < mvv_lva_key(move2);
-  };
-} reverse_comparison;
-
 // movetype
 
 enum : movetype_t {
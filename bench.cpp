@@ -0,0 +1,72 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include "modules/time.cpp"
+#include "base.cpp"
+#include "board.cpp"
+#include "search.cpp"
+#include "transposition.cpp"
+
+/***********************************************************************
+ *
+ * Module for the search benchmark.
+ *
+ * The benchmark searches a fixed list of positions to a fixed depth,
+ * each from a cleared transposition table and history. With a single
+ * thread the total node count only changes with the search and the
+ * evaluation, so it serves as a signature of functional changes, while
+ * the nodes per second measure the speed.
+ *
+***********************************************************************/
+
+constexpr int bench_default_depth = 10;
+constexpr int bench_default_threads = 1;
+constexpr u64_t bench_default_hash = 16;
+
+constexpr std::array<const char*, 12> bench_positions = {
+  "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+  "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+  "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1",
+  "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+  "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+  "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+  "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP1B1PPP/R2QKB1R w KQ - 0 8",
+  "2r3k1/pp3ppp/4p3/3n4/3P4/P4N2/1P3PPP/2R3K1 w - - 0 24",
+  "8/5pk1/6p1/8/3R4/6P1/5PK1/3r4 b - - 0 40",
+  "8/8/4k3/3p4/3P4/4K3/8/8 w - - 0 50",
+  "6k1/5ppp/8/8/8/8/5PPP/R5K1 w - - 0 1",
+};
+
+// search the benchmark positions and print the total nodes, time and nodes per second
+void bench(int depth=bench_default_depth, int threads=bench_default_threads, u64_t hash=bench_default_hash) {
+  depth = std::clamp(depth, 1, MAX_PV_DEPTH);
+  threads = std::clamp(threads, 1, MAX_THREADS);
+  hash = std::clamp<u64_t>(hash, 1, MAX_HASH_SIZE);
+  int original_threads = thread_count();
+  u64_t original_hash = table_size() >> 20;
+  set_threads(threads);
+  resize_table(hash, thread_count());
+  u64_t nodes = 0;
+  u64_t start_time = milliseconds();
+  for (const char* fen : bench_positions) {
+    Board board(fen);
+    clear_table(thread_count());
+    clear_history();
+    search(board, depth);
+    nodes += total_nodes();
+  };
+  u64_t time = milliseconds() - start_time;
+  std::cout << "\n";
+  std::cout << "Positions: " << bench_positions.size() << "\n";
+  std::cout << "Depth: " << depth << "\n";
+  std::cout << "Threads: " << thread_count() << "\n";
+  std::cout << "Hash: " << (table_size() >> 20) << " MiB\n";
+  std::cout << "Total time: " << time << " ms\n";
+  std::cout << "Nodes searched: " << nodes << "\n";
+  std::cout << "Nodes/second: " << nodes * 1000 / std::max<u64_t>(time, 1) << "\n";
+  set_threads(original_threads);
+  resize_table(original_hash, thread_count());
+};
@@ -4,6 +4,8 @@
 #include <string>
 #include "modules/list.cpp"
 #include "base.cpp"
+#include "nnue.cpp"
+#include "psqt.cpp"
 #include "zobrist.cpp"
 
 /***********************************************************************
@@ -30,6 +32,9 @@ public:
   square_t enpassant;
   u16_t halfmove_clock;
   u16_t fullmove_clock;
+  packed_score_t psq_score;
+  u8_t phase;
+  accumulator_t accumulator;
   Zobrist zobrist;
   List<undo_t, MAX_GAME_LENGTH> history;
   std::string starting_fen;
@@ -46,6 +51,9 @@ public:
     this->bitboards.fill(none);
     this->pieces.fill(none);
     this->piece_counts.fill(0);
+    this->psq_score = 0;
+    this->phase = 0;
+    this->accumulator.reset();
     this->zobrist.clear();
     this->history.clear();
     // setup bitboards and pieces
@@ -145,6 +153,10 @@ public:
     ++this->piece_counts[piece_type(piece)];
     ++this->piece_counts[color];
     ++this->piece_counts[none];
+    this->psq_score += psq_table[piece][square];
+    this->phase += phase_weight[piece];
+    if (use_nnue)
+      this->accumulator.add(piece, square);
     this->zobrist.update_piece(piece, square);
   };
 
@@ -169,6 +181,10 @@ public:
     --this->piece_counts[piece_type(piece)];
     --this->piece_counts[color];
     --this->piece_counts[none];
+    this->psq_score -= psq_table[piece][square];
+    this->phase -= phase_weight[piece];
+    if (use_nnue)
+      this->accumulator.remove(piece, square);
     this->zobrist.update_piece(piece, square);
   };
 
@@ -180,6 +196,14 @@ public:
     };
   };
 
+  // rebuild the accumulator from the pieces on the board
+  void refresh_accumulator() {
+    this->accumulator.reset();
+    for (square_t square = 0; square < 64; square++)
+      if (this->pieces[square] != none)
+        this->accumulator.add(this->pieces[square], square);
+  };
+
   // make a move on the board
   template <color_t color>
   void make(move_t move) {
@@ -208,7 +232,8 @@ public:
     square_t from = from(move);
     square_t to = to(move);
     this->remove_piece<color>(from);
-    this->remove_piece<opponent>(to);
+    if (capture(move) && !enpassant(move))
+      this->remove_piece<opponent>(to);
     this->place_piece<color>(target_piece(move), to);
     if (enpassant(move)) {
       if constexpr (color == white)
@@ -239,6 +264,39 @@ public:
       this->make<black>(move);
   };
 
+  // get the hash after a move without making it
+  template <color_t color>
+  hash_t key_after(move_t move) {
+    constexpr color_t opponent = opponent(color);
+    constexpr piece_t color_rook = to_color(rook, color);
+    constexpr piece_t opponent_pawn = to_color(pawn, opponent);
+    square_t from = from(move);
+    square_t to = to(move);
+    castling_t castling = this->castling & ~removed_castling(move);
+    square_t enpassant = none_square;
+    hash_t hash = this->zobrist.hash ^ zobrist_keys.turn_hash;
+    hash ^= zobrist_keys.castling_hash[this->castling] ^ zobrist_keys.castling_hash[castling];
+    hash ^= zobrist_keys.piece_hash[moved_piece(move)][from] ^ zobrist_keys.piece_hash[target_piece(move)][to];
+    if (enpassant(move)) {
+      if constexpr (color == white)
+        hash ^= zobrist_keys.piece_hash[opponent_pawn][to + 8];
+      else if constexpr (color == black)
+        hash ^= zobrist_keys.piece_hash[opponent_pawn][to - 8];
+    } else if (capture(move)) {
+      hash ^= zobrist_keys.piece_hash[captured_piece(move)][to];
+    } else if (castling(move)) {
+      hash ^= zobrist_keys.piece_hash[color_rook][to + (to > from) * 3 - 2];
+      hash ^= zobrist_keys.piece_hash[color_rook][to - (to > from) * 2 + 1];
+    } else if (double_pawn_push(move)) {
+      if constexpr (color == white)
+        enpassant = to + 8;
+      else if constexpr (color == black)
+        enpassant = to - 8;
+    };
+    hash ^= zobrist_keys.enpassant_hash[this->enpassant] ^ zobrist_keys.enpassant_hash[enpassant];
+    return hash;
+  };
+
   // undo a move on the board
   template <color_t color>
   void unmake() {
@@ -283,6 +341,41 @@ public:
       this->unmake<white>();
   };
 
+  // pass the turn to the opponent without moving a piece
+  template <color_t color>
+  void make_null() {
+    constexpr color_t opponent = opponent(color);
+    // add the undo object to the history, a null move is stored as none
+    this->history.push(undo_t {
+      none,
+      this->castling,
+      this->enpassant,
+      this->halfmove_clock,
+      this->zobrist.hash,
+    });
+    // the enpassant square expires with the turn
+    this->zobrist.update_enpassant(this->enpassant);
+    this->enpassant = none_square;
+    this->zobrist.update_enpassant(this->enpassant);
+    ++this->halfmove_clock;
+    if constexpr (color == black)
+      ++this->fullmove_clock;
+    this->turn = opponent;
+    this->zobrist.update_turn();
+  };
+
+  // undo a null move
+  template <color_t color>
+  void unmake_null() {
+    undo_t undo = this->history.pop();
+    this->enpassant = undo.enpassant;
+    this->halfmove_clock = undo.halfmove_clock;
+    this->turn = color;
+    if constexpr (color == black)
+      --this->fullmove_clock;
+    this->zobrist.set(undo.hash);
+  };
+
   // check if a position already exists in the history
   bool position_existed() {
     return this->history.count([this](undo_t undo) {
@@ -1,11 +1,20 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "modules/time.cpp"
 #include "base.cpp"
 #include "board.cpp"
+#include "evaluation.cpp"
+#include "nnue.cpp"
 #include "perft.cpp"
+#include "see.cpp"
 
 /***********************************************************************
  * 
@@ -42,10 +51,65 @@ void print_board(Board& board) {
   std::cout << "Fen: " << board.fen() << "\n";
 };
 
-// test a perft suite
-void perft_test_suite(Board& board, std::string epd_file_path) {
+struct perft_test_t {
+  int position;
+  std::string fen;
+  int depth;
+  u64_t expected;
+  u64_t nodes;
+  float time;
+  float mnps;
+  bool run;
+};
+
+struct perft_suite_options_t {
+  int threads = 1;
+  int max_depth = 0;
+  float time_budget = 0;
+  std::string report_path;
+};
+
+// write the results of a perft suite as csv or, for a .json path, as json
+void _write_perft_report(std::vector<perft_test_t>& tests, perft_suite_options_t& options, std::string epd_file_path, float wall_time) {
+  std::ofstream report(options.report_path);
+  if (!report.is_open()) {
+    error("Could not open file: " + options.report_path);
+    return;
+  };
+  auto status = [](perft_test_t& test) {
+    return !test.run ? "skipped" : (test.nodes == test.expected ? "passed" : "failed");
+  };
+  if (options.report_path.ends_with(".json")) {
+    report << "{\n";
+    report << "  \"suite\": \"" << epd_file_path << "\",\n";
+    report << "  \"threads\": " << options.threads << ",\n";
+    report << "  \"wall_time\": " << wall_time << ",\n";
+    report << "  \"tests\": [\n";
+    for (int index = 0; index < (int)tests.size(); index++) {
+      perft_test_t& test = tests[index];
+      report << "    {\"position\": " << test.position
+             << ", \"fen\": \"" << test.fen << "\""
+             << ", \"depth\": " << test.depth
+             << ", \"expected\": " << test.expected
+             << ", \"nodes\": " << test.nodes
+             << ", \"time\": " << test.time
+             << ", \"mnps\": " << test.mnps
+             << ", \"status\": \"" << status(test) << "\"}"
+             << (index + 1 < (int)tests.size() ? ",\n" : "\n");
+    };
+    report << "  ]\n";
+    report << "}\n";
+  } else {
+    report << "position,fen,depth,expected,nodes,time,mnps,status\n";
+    for (perft_test_t& test : tests)
+      report << test.position << "," << test.fen << "," << test.depth << "," << test.expected << ","
+             << test.nodes << "," << test.time << "," << test.mnps << "," << status(test) << "\n";
+  };
+};
+
+// test a perft suite, the positions are spread over the threads
+void perft_test_suite(std::string epd_file_path, perft_suite_options_t options) {
   log("Testing perft suite: " + epd_file_path);
-  std::string original_fen = board.fen();
   // open the file
   std::ifstream edp_file(epd_file_path);
   if (!edp_file.is_open()) {
@@ -55,54 +119,212 @@ void perft_test_suite(Board& board, std::string epd_file_path) {
       return;
     };
   };
-  int correct_positions = 0;
-  int total_positions = 0;
-  float total_time = 0;
-  u64_t total_nodes = 0;
-  float max_mnps = 0;
   // read the file line by line
-  // for each fen position, run perft at all depths
-  // and compare the results to the expected results
+  // for each fen position, collect the depths up to the cap and the expected results
+  std::vector<perft_test_t> tests;
+  std::vector<std::pair<int, int>> positions;
   std::string line;
   while (std::getline(edp_file, line)) {
     std::istringstream line_stream(line);
     std::string fen;
     std::getline(line_stream, fen, ';');
-    board.set_fen(fen);
-    std::cout << "\tFen: " << board.fen() << "\n";
+    int first_test = tests.size();
     std::string depth_token;
     std::string nodes_token;
     while (line_stream >> depth_token) {
       line_stream >> nodes_token;
       int depth = std::stoi(depth_token.substr(1));
-      u64_t nodes = std::stoll(nodes_token);
-      perft_result_t perft_result;
-      perft_result = perft<legal>(board, depth, false);
-      if (perft_result.nodes == nodes) {
-        std::cout << "       ";
-      } else {
-        std::cout << "FAILED!";
-        log("Perft failed at depth " + std::to_string(depth) + " for fen ", board.fen());
+      if (options.max_depth > 0 && depth > options.max_depth)
+        continue;
+      tests.push_back(perft_test_t{ (int)positions.size(), fen, depth, (u64_t)std::stoll(nodes_token), 0, 0, 0, false });
+    };
+    positions.push_back({first_test, (int)tests.size()});
+  };
+  // run the positions on the threads until all are done or the time budget is used up
+  u64_t start_time = milliseconds();
+  std::atomic<u64_t> next_position(0);
+  auto worker = [&]() {
+    u64_t position;
+    while ((position = next_position.fetch_add(1, std::memory_order_relaxed)) < positions.size()) {
+      if (options.time_budget > 0 && (milliseconds() - start_time) * 1e-3 > options.time_budget)
+        return;
+      auto [first_test, end_test] = positions[position];
+      if (first_test == end_test)
+        continue;
+      Board board(tests[first_test].fen);
+      for (int index = first_test; index < end_test; index++) {
+        perft_test_t& test = tests[index];
+        perft_result_t perft_result = perft<legal>(board, test.depth, false);
+        test.nodes = perft_result.nodes;
+        test.time = perft_result.time;
+        test.mnps = perft_result.mnps;
+        test.run = true;
+        if (test.nodes != test.expected)
+          log("Perft failed at depth " + std::to_string(test.depth) + " for fen ", board.fen());
       };
-      std::cout << "\t  Depth:" << depth;
-      std::cout << "\tResult: " << perft_result.nodes << "\n";
-      correct_positions += perft_result.nodes == nodes;
-      total_positions++;
-      total_time += perft_result.time;
-      total_nodes += perft_result.nodes;
-      max_mnps = std::max(max_mnps, perft_result.mnps);
     };
   };
+  std::vector<std::thread> workers;
+  for (int id = 0; id < std::clamp(options.threads, 1, MAX_THREADS); id++)
+    workers.emplace_back(worker);
+  for (std::thread& thread : workers)
+    thread.join();
+  float wall_time = (milliseconds() - start_time) * 1e-3;
+  // print the results in the order of the file
+  int correct_positions = 0;
+  int total_positions = 0;
+  int skipped_positions = 0;
+  float total_time = 0;
+  u64_t total_nodes = 0;
+  float max_mnps = 0;
+  int printed_position = -1;
+  for (perft_test_t& test : tests) {
+    if (!test.run) {
+      ++skipped_positions;
+      continue;
+    };
+    if (test.position != printed_position) {
+      std::cout << "\tFen: " << Board(test.fen).fen() << "\n";
+      printed_position = test.position;
+    };
+    std::cout << (test.nodes == test.expected ? "       " : "FAILED!");
+    std::cout << "\t  Depth:" << test.depth;
+    std::cout << "\tResult: " << test.nodes << "\n";
+    correct_positions += test.nodes == test.expected;
+    total_positions++;
+    total_time += test.time;
+    total_nodes += test.nodes;
+    max_mnps = std::max(max_mnps, test.mnps);
+  };
   std::cout << "Correct: " << correct_positions << "/" << total_positions << "\n";
+  if (skipped_positions > 0)
+    std::cout << "Skipped: " << skipped_positions << "\n";
   std::cout << "Total time: " << total_time << " s" << "\n";
+  std::cout << "Wall time: " << wall_time << " s" << "\n";
   std::cout << "Mean MNps: " << (total_nodes / total_time) * 1e-6 << "\n";
   std::cout << "Max MNps: " << max_mnps << "\n";
-  board.set_fen(original_fen);
+  std::cout << "Aggregate MNps: " << (total_nodes / std::max(wall_time, 1e-3f)) * 1e-6 << "\n";
+  if (!options.report_path.empty())
+    _write_perft_report(tests, options, epd_file_path, wall_time);
   log(
     "Finished testing perft suite: " + epd_file_path,
     "Correct: " + std::to_string(correct_positions) + "/" + std::to_string(total_positions),
+    "Skipped: " + std::to_string(skipped_positions),
     "Total time: " + std::to_string(total_time) + " s",
+    "Wall time: " + std::to_string(wall_time) + " s",
     "Mean MNps: " + std::to_string((total_nodes / total_time) * 1e-6),
     "Max MNps: " + std::to_string(max_mnps)
   );
+};
+
+// test a static exchange evaluation suite, each line holds a fen, a uci move and the expected score
+void see_test_suite(Board& board, std::string epd_file_path) {
+  std::ifstream edp_file(epd_file_path);
+  if (!edp_file.is_open()) {
+    edp_file.open("test/" + epd_file_path);
+    if (!edp_file.is_open()) {
+      error("Could not open file: " + epd_file_path);
+      return;
+    };
+  };
+  std::string original_fen = board.fen();
+  int correct_positions = 0;
+  int total_positions = 0;
+  std::string line;
+  while (std::getline(edp_file, line)) {
+    std::istringstream line_stream(line);
+    std::string fen;
+    std::string move_token;
+    score_t expected;
+    std::getline(line_stream, fen, ';');
+    std::getline(line_stream, move_token, ';');
+    if (!(line_stream >> expected))
+      continue;
+    board.set_fen(fen);
+    move_token.erase(std::remove(move_token.begin(), move_token.end(), ' '), move_token.end());
+    move_t move = board.from_uci(move_token);
+    score_t score = board.turn == white ? see<white>(board, move) : see<black>(board, move);
+    if (score == expected) {
+      std::cout << "       ";
+    } else {
+      std::cout << "FAILED!";
+      log("SEE failed for move " + move_token + " in fen ", board.fen());
+    };
+    std::cout << "\tFen: " << board.fen() << "\tMove: " << move_token << "\tSEE: " << score << " (" << expected << ")\n";
+    correct_positions += score == expected;
+    total_positions++;
+  };
+  std::cout << "Correct: " << correct_positions << "/" << total_positions << "\n";
+  board.set_fen(original_fen);
+};
+
+// count the positions below a board whose incremental accumulator differs from a rebuilt one
+template <color_t color>
+u64_t _accumulator_mismatches(Board& board, int depth) {
+  constexpr color_t opponent = opponent(color);
+  Board rebuilt = board;
+  rebuilt.refresh_accumulator();
+  u64_t mismatches = !std::equal(&board.accumulator.values[0][0], &board.accumulator.values[0][0] + 2 * nnue_hidden, &rebuilt.accumulator.values[0][0]);
+  if (depth == 0)
+    return mismatches;
+  move_stack_t legal_moves = generate<color, legal, move_stack_t>(board);
+  for (move_t move : legal_moves) {
+    board.make<color>(move);
+    mismatches += _accumulator_mismatches<opponent>(board, depth - 1);
+    board.unmake<color>();
+  };
+  return mismatches;
+};
+
+// evaluate every position of a list a number of times, return the evaluations per second
+float _evaluation_speed(std::vector<Board>& boards, int iterations) {
+  pawn_table_t* pawn_table = new pawn_table_t {};
+  u64_t start_time = nanoseconds();
+  i64_t checksum = 0;
+  for (int iteration = 0; iteration < iterations; iteration++)
+    for (Board& board : boards)
+      checksum += board.turn == white ? evaluate<white>(board, *pawn_table) : evaluate<black>(board, *pawn_table);
+  u64_t end_time = nanoseconds();
+  delete pawn_table;
+  // keep the compiler from dropping the evaluations
+  asm volatile("" : : "r"(checksum));
+  return (float)(boards.size() * iterations) / ((float)(end_time - start_time) * 1e-9);
+};
+
+// compare the speed of the classical and the neural evaluation, and verify the accumulator updates
+void eval_benchmark(std::string epd_file_path) {
+  constexpr int iterations = 1000;
+  constexpr int update_depth = 2;
+  std::ifstream edp_file(epd_file_path);
+  if (!edp_file.is_open()) {
+    edp_file.open("test/" + epd_file_path);
+    if (!edp_file.is_open()) {
+      error("Could not open file: " + epd_file_path);
+      return;
+    };
+  };
+  bool original_use_nnue = use_nnue;
+  use_nnue = true;
+  std::vector<Board> boards;
+  u64_t mismatches = 0;
+  std::string line;
+  while (std::getline(edp_file, line)) {
+    std::string fen = line.substr(0, line.find(';'));
+    Board position(fen);
+    position.refresh_accumulator();
+    mismatches += position.turn == white ?
+      _accumulator_mismatches<white>(position, update_depth) :
+      _accumulator_mismatches<black>(position, update_depth);
+    boards.push_back(position);
+  };
+  use_nnue = false;
+  float classical_speed = _evaluation_speed(boards, iterations);
+  use_nnue = true;
+  float nnue_speed = _evaluation_speed(boards, iterations);
+  use_nnue = original_use_nnue;
+  std::cout << "Positions: " << boards.size() << "\n";
+  std::cout << "Network: " << network_name() << "\n";
+  std::cout << "Accumulator mismatches: " << mismatches << "\n";
+  std::cout << "Classical Mevals/s: " << classical_speed * 1e-6 << "\n";
+  std::cout << "NNUE Mevals/s: " << nnue_speed * 1e-6 << "\n";
 };
\ No newline at end of file
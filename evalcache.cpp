@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include "base.cpp"
+
+/***********************************************************************
+ *
+ * Module to handle the evaluation cache.
+ *
+ * The cache is shared by all search threads and maps the hash of a
+ * position to its static evaluation. An entry is a single 64 bit word,
+ * the upper 48 bits of the hash with the score in the lower 16 bits,
+ * so it is read and written atomically without any lock. The size is
+ * given in MiB and rounded down to a power of two number of entries,
+ * a size of 0 disables the cache.
+ *
+***********************************************************************/
+
+constexpr u64_t _eval_cache_key_mask = 0xFFFFFFFFFFFF0000;
+
+// define the evaluation cache
+u64_t _eval_cache_size = 0;
+u64_t _eval_cache_index_mask = 0;
+std::atomic<u64_t>* _eval_cache = nullptr;
+
+// clear the evaluation cache
+void clear_eval_cache() {
+  for (u64_t index = 0; index < _eval_cache_size; index++)
+    _eval_cache[index].store(0, std::memory_order_relaxed);
+};
+
+// resize the evaluation cache to the given MiB, 0 frees the cache, halve the size until the allocation
+// succeeds and keep the old cache if even the smallest one does not fit, return if the full size was allocated
+bool resize_eval_cache(u64_t mib) {
+  if (mib == 0) {
+    delete[] _eval_cache;
+    _eval_cache = nullptr;
+    _eval_cache_size = 0;
+    _eval_cache_index_mask = 0;
+    return true;
+  };
+  mib = std::min<u64_t>(mib, MAX_EVAL_CACHE_SIZE);
+  u64_t requested_size = 1ULL << (63 - __builtin_clzll((mib << 20) / sizeof(u64_t)));
+  u64_t size = requested_size;
+  std::atomic<u64_t>* memory = nullptr;
+  for (; size >= (1ULL << 20) / sizeof(u64_t); size >>= 1) {
+    memory = new (std::nothrow) std::atomic<u64_t>[size];
+    if (memory != nullptr)
+      break;
+  };
+  if (memory == nullptr)
+    return false;
+  delete[] _eval_cache;
+  _eval_cache = memory;
+  _eval_cache_size = size;
+  _eval_cache_index_mask = _eval_cache_size - 1;
+  clear_eval_cache();
+  return size == requested_size;
+};
+
+// allocate the default evaluation cache at startup
+const bool _eval_cache_initialized = (resize_eval_cache(DEFAULT_EVAL_CACHE_SIZE), true);
+
+// check if the search uses the evaluation cache
+bool eval_cache_enabled() {
+  return _eval_cache != nullptr;
+};
+
+// look up the score of a position, return if it was found
+bool probe_eval_cache(hash_t hash, score_t& score) {
+  u64_t entry = _eval_cache[hash & _eval_cache_index_mask].load(std::memory_order_relaxed);
+  if ((entry ^ hash) & _eval_cache_key_mask)
+    return false;
+  score = (score_t)(u16_t)entry;
+  return true;
+};
+
+// store the score of a position
+void store_eval_cache(hash_t hash, score_t score) {
+  _eval_cache[hash & _eval_cache_index_mask].store((hash & _eval_cache_key_mask) | (u16_t)score, std::memory_order_relaxed);
+};
+
+// load the entry of a position into the cache ahead of its probe
+void prefetch_eval_cache(hash_t hash) {
+  __builtin_prefetch(&_eval_cache[hash & _eval_cache_index_mask]);
+};
+
+// get the size of the evaluation cache
+u64_t eval_cache_size() {
+  return sizeof(u64_t) * _eval_cache_size;
+};
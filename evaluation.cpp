@@ -1,14 +1,25 @@
 #pragma once
 
+#include <algorithm>
 #include <string>
-#include "movegen/movegen.cpp"
+#include "attack.cpp"
 #include "base.cpp"
 #include "board.cpp"
+#include "nnue.cpp"
+#include "pawns.cpp"
+#include "psqt.cpp"
 
 /***********************************************************************
  * 
  * Module for the evaluation heuristic.
  * 
+ * The packed piece-square score and the game phase are kept
+ * incrementally by the board, they are blended once per evaluation.
+ * The pawn structure is cached in the pawn table of the calling
+ * thread. Mobility is counted from pseudo-legal attacks, mate and
+ * stalemate are detected by the search. With NNUE enabled the network
+ * output replaces the whole heuristic.
+ * 
 ***********************************************************************/
 
 enum : score_t {
@@ -55,136 +66,6 @@ constexpr u8_t inverse_mobility_weight = 2;
 constexpr u8_t inverse_attack_weight = 3;
 constexpr u8_t king_safety_weight = 3;
 
-constexpr score_t pawn_value[64] = {
-    0,   0,   0,   0,   0,   0,   0,   0,
-  150, 150, 150, 150, 150, 150, 150, 150,
-  110, 110, 120, 130, 130, 120, 110, 110,
-  105, 105, 110, 125, 125, 110, 105, 105,
-  100, 100, 100, 120, 120, 100, 100, 100,
-  105,  95,  90, 100, 100,  90,  95, 105,
-  105, 110, 110,  80,  80, 110, 110, 105,
-    0,   0,   0,   0,   0,   0,   0,   0,
-};
-
-constexpr score_t knight_value[64] = {
-  300, 310, 320, 320, 320, 320, 310, 300,
-  310, 330, 350, 350, 350, 350, 330, 310,
-  320, 350, 360, 365, 365, 360, 350, 320,
-  320, 355, 365, 370, 370, 365, 355, 320,
-  320, 350, 365, 370, 370, 365, 350, 320,
-  320, 355, 360, 365, 365, 360, 355, 320,
-  310, 330, 350, 355, 355, 350, 330, 310,
-  300, 310, 320, 320, 320, 320, 310, 300,
-};
-
-constexpr score_t bishop_value[64] = {
-  330, 340, 340, 340, 340, 340, 340, 330,
-  340, 350, 350, 350, 350, 350, 350, 340,
-  340, 350, 355, 360, 360, 355, 350, 340,
-  340, 355, 355, 360, 360, 355, 355, 340,
-  340, 350, 360, 360, 360, 360, 350, 340,
-  340, 360, 360, 360, 360, 360, 360, 340,
-  340, 355, 350, 350, 350, 350, 355, 340,
-  330, 340, 340, 340, 340, 340, 340, 330,
-};
-
-constexpr score_t rook_value[64] = {
-  525, 525, 525, 525, 525, 525, 525, 525,
-  530, 535, 535, 535, 535, 535, 535, 530,
-  520, 525, 525, 525, 525, 525, 525, 520,
-  520, 525, 525, 525, 525, 525, 525, 520,
-  520, 525, 525, 525, 525, 525, 525, 520,
-  520, 525, 525, 525, 525, 525, 525, 520,
-  520, 525, 525, 525, 525, 525, 525, 520,
-  525, 525, 525, 530, 530, 525, 525, 525,
-};
-
-constexpr score_t queen_value[64] = {
-   980,  990,  990,  995,  995,  990,  990,  980,
-   990, 1000, 1000, 1000, 1000, 1000, 1000,  990,
-   990, 1000, 1005, 1005, 1005, 1005, 1000,  990,
-   995, 1000, 1005, 1005, 1005, 1005, 1000,  995,
-  1000, 1000, 1005, 1005, 1005, 1005, 1000,  995,
-   990, 1005, 1005, 1005, 1005, 1005, 1000,  990,
-   990, 1000, 1005, 1000, 1000, 1000, 1000,  990,
-   980,  990,  990,  995,  995,  990,  990,  980,
-};
-
-constexpr score_t king_value_middlegame[64] = {
-  -30, -40, -40, -50, -50, -40, -40, -30,
-  -30, -40, -40, -50, -50, -40, -40, -30,
-  -30, -40, -40, -50, -50, -40, -40, -30,
-  -30, -40, -40, -50, -50, -40, -40, -30,
-  -20, -30, -30, -40, -40, -30, -30, -20,
-  -10, -20, -20, -20, -20, -20, -20, -10,
-   20,  20,   0,   0,   0,   0,  20,  20,
-   20,  30,  10,   0,   0,  10,  30,  20,
-};
-
-constexpr score_t king_value_endgame[64] = {
-  -50, -40, -30, -20, -20, -30, -40, -50,
-  -30, -20, -10,   0,   0, -10, -20, -30,
-  -30, -10,  20,  30,  30,  20, -10, -30,
-  -30, -10,  30,  40,  40,  30, -10, -30,
-  -30, -10,  30,  40,  40,  30, -10, -30,
-  -30, -10,  20,  30,  30,  20, -10, -30,
-  -30, -30,   0,   0,   0,   0, -30, -30,
-  -50, -30, -30, -30, -30, -30, -30, -50,
-};
-
-// evaluate a piece on a given square
-template <piece_t piece>
-score_t value(square_t square, u8_t endgame_factor=0) {
-  if constexpr (piece == white_pawn)
-    return pawn_value[square];
-  else if constexpr (piece == black_pawn)
-    return pawn_value[square ^ 56];
-  else if constexpr (piece == white_knight)
-    return knight_value[square];
-  else if constexpr (piece == black_knight)
-    return knight_value[square ^ 56];
-  else if constexpr (piece == white_bishop)
-    return bishop_value[square];
-  else if constexpr (piece == black_bishop)
-    return bishop_value[square ^ 56];
-  else if constexpr (piece == white_rook)
-    return rook_value[square];
-  else if constexpr (piece == black_rook)
-    return rook_value[square ^ 56];
-  else if constexpr (piece == white_queen)
-    return queen_value[square];
-  else if constexpr (piece == black_queen)
-    return queen_value[square ^ 56];
-  else if constexpr (piece == white_king)
-    return ((endgame_factor * king_value_endgame[square]) >> 8) +
-           (((256 - endgame_factor) * king_value_middlegame[square]) >> 8);
-  else if constexpr (piece == black_king)
-    return ((endgame_factor * king_value_endgame[square ^ 56]) >> 8) +
-           (((256 - endgame_factor) * king_value_middlegame[square ^ 56]) >> 8);
-  return 0;
-};
-
-// jump table for piece values
-constexpr score_t (*(value_jump_table[32]))(square_t, u8_t) = {
-  value< 0>, value< 1>, value< 2>, value< 3>, value< 4>, value< 5>, value< 6>, value< 7>,
-  value< 8>, value< 9>, value<10>, value<11>, value<12>, value<13>, value<14>, value<15>,
-  value<16>, value<17>, value<18>, value<19>, value<20>, value<21>, value<22>, value<23>,
-  value<24>, value<25>, value<26>, value<27>, value<28>, value<29>, value<30>, value<31>,
-};
-
-// calculate the endgame factor
-u8_t get_endgame_factor(Board& board) {
-  return (
-    (
-      board.piece_counts[pawn] + 2
-    ) * (
-      ((board.piece_counts[knight] + board.piece_counts[bishop]) << 1) +
-      (board.piece_counts[rook] << 2) +
-      (board.piece_counts[queen] << 3)
-    )
-  ) >> 1;
-};
-
 // check if a given color is in check
 template<color_t color>
 bool is_check(Board& board) {
@@ -194,6 +75,13 @@ bool is_check(Board& board) {
   return attackers<opponent>(board, color_king_square);
 };
 
+// check if a given color has any pieces besides pawns and the king
+template<color_t color>
+bool has_non_pawn_material(Board& board) {
+  constexpr piece_t color_pawn = to_color(pawn, color);
+  return board.piece_counts[color] - board.piece_counts[color_pawn] > 1;
+};
+
 // calculate the king safety score
 template<color_t color>
 u64_t king_safety(Board& board, bitboard_t opponent_attacks) {
@@ -202,38 +90,74 @@ u64_t king_safety(Board& board, bitboard_t opponent_attacks) {
   return popcount(attack<king>(color_king_square) & ~opponent_attacks);
 };
 
-// evaluate a board
+// get the pseudo-legal mobility of a color and collect its attacked squares
+template<color_t color>
+int mobility(Board& board, bitboard_t& attacked_squares) {
+  constexpr piece_t color_pawn = to_color(pawn, color);
+  constexpr piece_t color_knight = to_color(knight, color);
+  constexpr piece_t color_bishop = to_color(bishop, color);
+  constexpr piece_t color_rook = to_color(rook, color);
+  constexpr piece_t color_queen = to_color(queen, color);
+  constexpr piece_t color_king = to_color(king, color);
+  bitboard_t targets = ~board.bitboards[color];
+  int mobility = 0;
+  attacked_squares = multi_pawn_attack<color>(board.bitboards[color_pawn]);
+  attacked_squares |= attack<king>(get_lsb(board.bitboards[color_king]));
+  bitboard_t knights = board.bitboards[color_knight];
+  while (knights) {
+    square_t square = pop_lsb(knights);
+    bitboard_t piece_attacks = attack<knight>(square);
+    attacked_squares |= piece_attacks;
+    mobility += popcount(piece_attacks & targets);
+  };
+  bitboard_t bishops = board.bitboards[color_bishop];
+  while (bishops) {
+    square_t square = pop_lsb(bishops);
+    bitboard_t piece_attacks = attack<bishop>(square, board.bitboards[none]);
+    attacked_squares |= piece_attacks;
+    mobility += popcount(piece_attacks & targets);
+  };
+  bitboard_t rooks = board.bitboards[color_rook];
+  while (rooks) {
+    square_t square = pop_lsb(rooks);
+    bitboard_t piece_attacks = attack<rook>(square, board.bitboards[none]);
+    attacked_squares |= piece_attacks;
+    mobility += popcount(piece_attacks & targets);
+  };
+  bitboard_t queens = board.bitboards[color_queen];
+  while (queens) {
+    square_t square = pop_lsb(queens);
+    bitboard_t piece_attacks = attack<queen>(square, board.bitboards[none]);
+    attacked_squares |= piece_attacks;
+    mobility += popcount(piece_attacks & targets);
+  };
+  return mobility;
+};
+
+// evaluate a board, the side to move is expected to have a legal move
 template <color_t color>
-score_t evaluate(Board& board) {
+score_t evaluate(Board& board, pawn_table_t& pawn_table) {
   constexpr color_t opponent = opponent(color);
-  constexpr std::array<piece_t, 6> pieces = pieces_by_color[none];
-  u64_t legal_moves = generate<color, legal, u64_t>(board);
-  if (legal_moves == 0) {
-    if (is_check<color>(board))
-      return -checkmate;
-    else
-      return draw;
-  };
+  constexpr piece_t color_king = to_color(king, color);
+  if (use_nnue)
+    return std::clamp<i32_t>(nnue_output<color>(board.accumulator), -max_eval, max_eval);
+  bitboard_t color_attacks;
+  bitboard_t opponent_attacks;
+  int color_mobility = mobility<color>(board, color_attacks);
+  int opponent_mobility = mobility<opponent>(board, opponent_attacks);
   score_t score = initial_score;
-  score -= is_check<color>(board) * check_weight;
-  u64_t opponent_legal_moves = generate<opponent, legal, u64_t>(board);
-  score += (popcount(legal_moves) - popcount(opponent_legal_moves)) >> inverse_mobility_weight;
-  bitboard_t color_attacks = attacks<color>(board);
-  bitboard_t opponent_attacks = attacks<opponent>(board);
-  score += (popcount(color_attacks) - popcount(opponent_attacks)) >> inverse_attack_weight; 
+  score -= (bool)(opponent_attacks & board.bitboards[color_king]) * check_weight;
+  score += (color_mobility - opponent_mobility) >> inverse_mobility_weight;
+  score += (popcount(color_attacks) - popcount(opponent_attacks)) >> inverse_attack_weight;
   score += (king_safety<color>(board, opponent_attacks) - king_safety<opponent>(board, color_attacks)) << king_safety_weight;
-  u8_t endgame_factor = get_endgame_factor(board);
-  for (piece_t piece : pieces) {
-    bitboard_t color_piece_bitboard = board.bitboards[to_color(piece, color)];
-    bitboard_t opponent_piece_bitboard = board.bitboards[to_color(piece, opponent)];
-    while (color_piece_bitboard) {
-      square_t square = pop_lsb(color_piece_bitboard);
-      score += value_jump_table[to_color(piece, color)](square, endgame_factor);
-    };
-    while (opponent_piece_bitboard) {
-      square_t square = pop_lsb(opponent_piece_bitboard);
-      score -= value_jump_table[to_color(piece, opponent)](square, endgame_factor);
-    };
-  };
+  pawn_entry_t& pawn_entry = pawn_table.probe(board);
+  score_t psq_score = taper(
+    board.psq_score + pawn_entry.score + unblocked_passed_pawns(board, pawn_entry.passed_pawns),
+    board.phase
+  );
+  if constexpr (color == white)
+    score += psq_score;
+  else
+    score -= psq_score;
   return score;
-};
\ No newline at end of file
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include "base.cpp"
+#include "board.cpp"
+
+/***********************************************************************
+ *
+ * Module for the quiet move ordering heuristics.
+ *
+ * Every search thread keeps two killer moves per ply, the last quiet
+ * moves that caused a beta cutoff there, a butterfly history indexed by
+ * color, from and to square, and a countermove table that maps the
+ * piece and target square of the previous move to the quiet move that
+ * refuted it.
+ *
+ * The history uses gravity updates: a bonus shrinks as the entry
+ * approaches the maximum, so the scores stay bounded and old cutoffs
+ * fade out while new ones come in.
+ *
+***********************************************************************/
+
+constexpr int max_history = 16384;
+constexpr int max_history_bonus = 1200;
+
+struct history_t {
+  std::array<std::array<move_t, 2>, MAX_PV_DEPTH + 1> killers;
+  std::array<std::array<std::array<i16_t, 64>, 64>, 2> butterfly;
+  std::array<std::array<move_t, 64>, 32> countermoves;
+
+  // clear the killer moves, they only relate to the positions of one search
+  void clear_killers() {
+    for (std::array<move_t, 2>& killer : this->killers)
+      killer.fill(none);
+  };
+
+  // clear all tables
+  void clear() {
+    this->clear_killers();
+    for (std::array<std::array<i16_t, 64>, 64>& from_table : this->butterfly)
+      for (std::array<i16_t, 64>& to_table : from_table)
+        to_table.fill(0);
+    for (std::array<move_t, 64>& piece_table : this->countermoves)
+      piece_table.fill(none);
+  };
+
+  // get the history score of a quiet move
+  int score(color_t color, move_t move) {
+    return this->butterfly[color >> 1][from(move)][to(move)];
+  };
+
+  // get the move that refuted the previous move before
+  move_t countermove(move_t previous_move) {
+    return previous_move == none ? (move_t)none : this->countermoves[moved_piece(previous_move)][to(previous_move)];
+  };
+
+  // add a bonus or a malus to the history of a quiet move
+  void update_history(color_t color, move_t move, int bonus) {
+    i16_t& entry = this->butterfly[color >> 1][from(move)][to(move)];
+    entry += bonus - entry * std::abs(bonus) / max_history;
+  };
+
+  // record a quiet move that caused a beta cutoff, punish the quiet moves searched before it
+  template <int SIZE>
+  void update(color_t color, int ply, int depth, move_t move, move_t previous_move, List<move_t, SIZE>& searched_quiets) {
+    if (this->killers[ply][0] != move) {
+      this->killers[ply][1] = this->killers[ply][0];
+      this->killers[ply][0] = move;
+    };
+    if (previous_move != none)
+      this->countermoves[moved_piece(previous_move)][to(previous_move)] = move;
+    int bonus = std::min(depth * depth * 16, max_history_bonus);
+    this->update_history(color, move, bonus);
+    for (move_t quiet : searched_quiets)
+      if (quiet != move)
+        this->update_history(color, quiet, -bonus);
+  };
+};
+
+// get the last move played on a board
+move_t previous_move(Board& board) {
+  return board.history.empty() ? (move_t)none : board.history[board.history.size() - 1].move;
+};
@@ -281,4 +281,6 @@ constexpr std::array<bitboard_t, 88507> _generate_magic_table() {
 	};
 	return magic_table;
 };
-constexpr std::array<bitboard_t, 88507> magic_table = _generate_magic_table();
\ No newline at end of file
+#ifndef USE_PEXT
+constexpr std::array<bitboard_t, 88507> magic_table = _generate_magic_table();
+#endif
\ No newline at end of file
@@ -1,6 +1,7 @@
 # pragma once
 
 #include <fstream>
+#include <mutex>
 #include <string>
 #include "time.cpp"
 
@@ -8,52 +9,50 @@
  * 
  *  Module for logging.
  * 
+ *  The log file is opened once and kept open, every message is
+ *  flushed so nothing is lost on a crash. Messages may be written
+ *  from multiple threads.
+ * 
 ***********************************************************************/
 
 static std::string _log_file_path = "log.txt";
+static std::ofstream _log_file;
+static std::mutex _log_mutex;
 
 void setup_log_path(std::string path) {
+  std::lock_guard<std::mutex> lock(_log_mutex);
+  if (_log_file.is_open())
+    _log_file.close();
   _log_file_path = path;
 };
 
 template<typename... Args>
-void log(Args... args) {
-  std::ofstream log_file(_log_file_path, std::ios::app);
-  log_file << "[" << timestamp() << " DEBUG]   ";
+void _write_log(const char* label, Args... args) {
+  std::lock_guard<std::mutex> lock(_log_mutex);
+  if (!_log_file.is_open())
+    _log_file.open(_log_file_path, std::ios::app);
+  _log_file << "[" << timestamp() << " " << label;
   bool first = true;
   for (auto arg : {args...}) {
     if (!first)
-      log_file << "                              ";
-    log_file << arg << "\n";
+      _log_file << "                              ";
+    _log_file << arg << "\n";
     first = false;
   };
-  log_file.close();
+  _log_file.flush();
+};
+
+template<typename... Args>
+void log(Args... args) {
+  _write_log("DEBUG]   ", args...);
 };
 
 template<typename... Args>
 void warning(Args... args) {
-  std::ofstream log_file(_log_file_path, std::ios::app);
-  log_file << "[" << timestamp() << " WARNING] ";
-  bool first = true;
-  for (auto arg : {args...}) {
-    if (!first)
-      log_file << "                              ";
-    log_file << arg << "\n";
-    first = false;
-  };
-  log_file.close();
+  _write_log("WARNING] ", args...);
 };
 
 template<typename... Args>
 void error(Args... args) {
-  std::ofstream log_file(_log_file_path, std::ios::app);
-  log_file << "[" << timestamp() << " ERROR]   ";
-  bool first = true;
-  for (auto arg : {args...}) {
-    if (!first)
-      log_file << "                              ";
-    log_file << arg << "\n";
-    first = false;
-  };
-  log_file.close();
-};
\ No newline at end of file
+  _write_log("ERROR]   ", args...);
+};
@@ -11,4 +11,12 @@ T random() {
 
 void seed(u64_t seed) {
   _random_generator.seed(seed);
-};
\ No newline at end of file
+};
+
+// splitmix64 generator that can be evaluated at compile time
+constexpr u64_t splitmix64(u64_t& state) {
+  u64_t z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+};
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstdlib>
+#include <string>
+#include <sys/mman.h>
 #include <sys/sysinfo.h>
 
 unsigned long long free_ram() {
@@ -44,4 +47,66 @@ unsigned long long total_memory() {
 
 unsigned long long used_memory() {
   return used_ram() + used_swap();
-}
\ No newline at end of file
+}
+
+/***********************************************************************
+ * 
+ *  Allocation of large memory blocks backed by huge pages.
+ * 
+ *  Explicit huge pages are tried first, then transparent huge pages,
+ *  then plain aligned memory. The mode used is needed to free it.
+ * 
+***********************************************************************/
+
+enum : unsigned char {
+  no_allocation,
+  hugetlb_allocation,
+  transparent_huge_page_allocation,
+  default_allocation,
+};
+
+constexpr unsigned long long huge_page_size = 1ULL << 21;
+
+std::string allocation_to_string(unsigned char allocation) {
+  switch (allocation) {
+    case hugetlb_allocation:               return "explicit huge pages";
+    case transparent_huge_page_allocation: return "transparent huge pages";
+    case default_allocation:               return "default pages";
+    default:                               return "none";
+  };
+};
+
+// round a size up to a multiple of the huge page size
+unsigned long long huge_page_aligned(unsigned long long size) {
+  return (size + huge_page_size - 1) & ~(huge_page_size - 1);
+}
+
+void* allocate_large(unsigned long long size, unsigned char& allocation) {
+  size = huge_page_aligned(size);
+  void* memory = nullptr;
+#ifdef MAP_HUGETLB
+  memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (memory != MAP_FAILED) {
+    allocation = hugetlb_allocation;
+    return memory;
+  }
+#endif
+  memory = std::aligned_alloc(huge_page_size, size);
+  if (memory == nullptr) {
+    allocation = no_allocation;
+    return nullptr;
+  }
+  allocation = default_allocation;
+#ifdef MADV_HUGEPAGE
+  if (madvise(memory, size, MADV_HUGEPAGE) == 0)
+    allocation = transparent_huge_page_allocation;
+#endif
+  return memory;
+}
+
+void free_large(void* memory, unsigned long long size, unsigned char allocation) {
+  if (allocation == hugetlb_allocation)
+    munmap(memory, huge_page_aligned(size));
+  else if (allocation != no_allocation)
+    std::free(memory);
+}
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <array>
+#include "movegen/movegen.cpp"
+#include "attack.cpp"
+#include "base.cpp"
+#include "board.cpp"
+#include "evaluation.cpp"
+#include "history.cpp"
+#include "see.cpp"
+
+/***********************************************************************
+ *
+ * Module for the staged move picker.
+ *
+ * The picker hands out the moves of a position one at a time, in
+ * stages: first the moves of the pv and the transposition table, then
+ * the good captures, the quiet moves and finally the bad captures.
+ * A stage is only generated once the previous one is exhausted, so a
+ * cutoff on an early move saves the generation of the later ones.
+ *
+ * The captures come from generate<capture>, the quiet moves from
+ * generate<quiet | check> without the captures, which together are
+ * exactly the legal moves. Moves are picked best first by score: the
+ * captures by victim and attacker, the quiet moves checks first and
+ * then by the killers, the countermove and the history of the thread.
+ *
+***********************************************************************/
+
+constexpr i64_t quiet_check_score = 1LL << 32;
+constexpr i64_t killer_score = 1 << 30;
+constexpr i64_t countermove_score = 1 << 29;
+
+enum : u8_t {
+  hash_moves_stage,
+  generate_captures_stage,
+  good_captures_stage,
+  generate_quiets_stage,
+  quiets_stage,
+  bad_captures_stage,
+  done_stage,
+};
+
+// check if a move from the pv or the transposition table is legal in a position
+template <color_t color>
+bool is_valid(Board& board, move_t move) {
+  constexpr color_t opponent = opponent(color);
+  constexpr piece_t color_pawn = to_color(pawn, color);
+  constexpr piece_t opponent_pawn = to_color(pawn, opponent);
+  constexpr bitboard_t start_rank = (color == white ? rank_2 : rank_7);
+  constexpr bitboard_t promotion_rank = (color == white ? rank_8 : rank_1);
+  constexpr int push_offset = (color == white ? -8 : 8);
+  if (move == none)
+    return false;
+  square_t from = from(move);
+  square_t to = to(move);
+  piece_t moved_piece = moved_piece(move);
+  piece_t captured_piece = captured_piece(move);
+  piece_t target_piece = target_piece(move);
+  bitboard_t occupancy = board.bitboards[none];
+  if (color(moved_piece) != color || board.pieces[from] != moved_piece)
+    return false;
+  // the target square has to hold the captured piece
+  if (enpassant(move)) {
+    if (moved_piece != color_pawn || to != board.enpassant || captured_piece != opponent_pawn)
+      return false;
+  } else if (board.pieces[to] != captured_piece || (capture(move) && (color(captured_piece) != opponent || piece_type(captured_piece) == king))) {
+    return false;
+  };
+  // only pawns on the last rank promote, only kings castle
+  if (promotion(move) != (moved_piece == color_pawn && (bool)(bitboard(to) & promotion_rank)))
+    return false;
+  if (promotion(move) ? (color(target_piece) != color || piece_type(target_piece) < knight || piece_type(target_piece) > queen) : target_piece != moved_piece)
+    return false;
+  if ((double_pawn_push(move) || enpassant(move)) && moved_piece != color_pawn)
+    return false;
+  if (castling(move) && piece_type(moved_piece) != king)
+    return false;
+  // the piece has to reach the target square
+  bool reachable = false;
+  switch (piece_type(moved_piece)) {
+    case pawn:
+      if (capture(move))
+        reachable = attack<color_pawn>(from) & bitboard(to);
+      else if (double_pawn_push(move))
+        reachable = (bitboard(from) & start_rank) && to == from + 2 * push_offset && board.pieces[from + push_offset] == none;
+      else
+        reachable = to == from + push_offset;
+      break;
+    case knight:
+      reachable = attack<knight>(from) & bitboard(to);
+      break;
+    case bishop:
+      reachable = attack<bishop>(from, occupancy) & bitboard(to);
+      break;
+    case rook:
+      reachable = attack<rook>(from, occupancy) & bitboard(to);
+      break;
+    case queen:
+      reachable = attack<queen>(from, occupancy) & bitboard(to);
+      break;
+    case king:
+      if (castling(move)) {
+        castling_t right = color == white ? (to == g1 ? white_OO : white_OOO) : (to == g8 ? black_OO : black_OOO);
+        bitboard_t rook_traverse = color == white ? (to == g1 ? white_OO_rook_traverse : white_OOO_rook_traverse) : (to == g8 ? black_OO_rook_traverse : black_OOO_rook_traverse);
+        bitboard_t king_traverse = color == white ? (to == g1 ? white_OO_king_traverse : white_OOO_king_traverse) : (to == g8 ? black_OO_king_traverse : black_OOO_king_traverse);
+        reachable = (board.castling & right) && !(occupancy & rook_traverse) && (to == g1 || to == c1 || to == g8 || to == c8);
+        while (reachable && king_traverse) {
+          square_t square = pop_lsb(king_traverse);
+          reachable = !attackers<opponent>(board, square);
+        };
+      } else {
+        reachable = attack<king>(from) & bitboard(to);
+      };
+      break;
+  };
+  if (!reachable)
+    return false;
+  // the move may not leave the own king in check and has to carry the right check flag
+  board.make<color>(move);
+  bool legal = !is_check<color>(board) && is_check<opponent>(board) == (bool)check(move);
+  board.unmake<color>();
+  return legal;
+};
+
+template <color_t color>
+class MovePicker {
+private:
+  Board& board;
+  history_t& history;
+  int ply;
+  std::array<move_t, 2> hash_moves;
+  int hash_index;
+  u8_t stage;
+  move_stack_t moves;
+  std::array<i64_t, MAX_MOVE_GENERATION_SIZE> scores;
+  int index;
+  move_stack_t bad_captures;
+  int bad_index;
+
+  // check if a move was already handed out as a hash move
+  bool is_hash_move(move_t move) {
+    return move == this->hash_moves[0] || move == this->hash_moves[1];
+  };
+
+  // move the best scored remaining move to the front and return it
+  move_t pick_best() {
+    int best = this->index;
+    for (int index = this->index + 1; index < this->moves.size(); index++)
+      if (this->scores[index] > this->scores[best])
+        best = index;
+    std::swap(this->moves[best], this->moves[this->index]);
+    std::swap(this->scores[best], this->scores[this->index]);
+    return this->moves[this->index++];
+  };
+
+  // score the captures by the most valuable victim and least valuable attacker
+  void score_captures() {
+    for (int index = 0; index < this->moves.size(); index++)
+      this->scores[index] = mvv_lva_key(this->moves[index]);
+  };
+
+  // score the quiet moves, checks first, then by the killers, the countermove and the history
+  void score_quiets() {
+    std::array<move_t, 2>& killers = this->history.killers[this->ply];
+    move_t countermove = this->history.countermove(previous_move(this->board));
+    for (int index = 0; index < this->moves.size(); index++) {
+      move_t move = this->moves[index];
+      if (move == killers[0])
+        this->scores[index] = killer_score + 1;
+      else if (move == killers[1])
+        this->scores[index] = killer_score;
+      else if (move == countermove)
+        this->scores[index] = countermove_score;
+      else
+        this->scores[index] = this->history.score(color, move);
+      if (check(move))
+        this->scores[index] += quiet_check_score;
+    };
+  };
+
+  // check if a capture loses material in the static exchange evaluation
+  bool is_bad_capture(move_t move) {
+    return see<color>(this->board, move) < 0;
+  };
+
+public:
+  MovePicker(Board& board, history_t& history, int ply, move_t pv_move, move_t tt_move) : board(board), history(history), ply(ply) {
+    this->hash_moves = {pv_move, tt_move == pv_move ? (move_t)none : tt_move};
+    this->hash_index = 0;
+    this->stage = hash_moves_stage;
+    this->index = 0;
+    this->bad_index = 0;
+  };
+
+  // get the next move, none once all moves were handed out
+  move_t next() {
+    while (true) {
+      switch (this->stage) {
+        case hash_moves_stage:
+          while (this->hash_index < 2) {
+            move_t move = this->hash_moves[this->hash_index++];
+            if (is_valid<color>(this->board, move))
+              return move;
+          };
+          ++this->stage;
+          break;
+        case generate_captures_stage:
+          this->moves = generate<color, capture, move_stack_t>(this->board);
+          this->score_captures();
+          this->index = 0;
+          ++this->stage;
+          break;
+        case good_captures_stage:
+          while (this->index < this->moves.size()) {
+            move_t move = this->pick_best();
+            if (this->is_hash_move(move))
+              continue;
+            if (this->is_bad_capture(move)) {
+              this->bad_captures.push(move);
+              continue;
+            };
+            return move;
+          };
+          ++this->stage;
+          break;
+        case generate_quiets_stage:
+          this->moves = generate<color, quiet | check, move_stack_t>(this->board);
+          this->score_quiets();
+          this->index = 0;
+          ++this->stage;
+          break;
+        case quiets_stage:
+          while (this->index < this->moves.size()) {
+            move_t move = this->pick_best();
+            if (capture(move) || this->is_hash_move(move))
+              continue;
+            return move;
+          };
+          ++this->stage;
+          break;
+        case bad_captures_stage:
+          if (this->bad_index < this->bad_captures.size())
+            return this->bad_captures[this->bad_index++];
+          ++this->stage;
+          break;
+        default:
+          return none;
+      };
+    };
+  };
+};
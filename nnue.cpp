@@ -0,0 +1,243 @@
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "modules/random.cpp"
+#include "base.cpp"
+#include "psqt.cpp"
+
+/***********************************************************************
+ *
+ * Module for the efficiently updatable neural network evaluation.
+ *
+ * The network is a 768 -> 2x128 -> 1 perspective network. Each of the
+ * 768 inputs is a piece of a color on a square, seen from white and
+ * from black. The two halves of the hidden layer, the accumulators,
+ * are kept by the board and updated with every placed or removed
+ * piece. The output is a clipped ReLU over the accumulator of the side
+ * to move followed by the one of the opponent.
+ *
+ * The kernels use AVX2 or SSE2 when the compiler targets them, else a
+ * scalar loop. A network file holds little endian int16 values in the
+ * order feature weights, feature biases, output weights, output bias.
+ *
+ * Without a file the default network is used. It is not trained, its
+ * first neuron sums the middlegame piece-square values of the own
+ * pieces, so it plays sensibly while testing the update and the
+ * kernels. The other neurons carry pseudo random feature weights and
+ * do not reach the output.
+ *
+***********************************************************************/
+
+constexpr int nnue_inputs = 768;
+constexpr int nnue_hidden = 128;
+constexpr i32_t nnue_clip = 255;
+constexpr i32_t nnue_output_quantization = 64;
+constexpr i32_t nnue_scale = 400;
+constexpr i32_t _default_psq_divisor = 20;
+#define NNUE_DEFAULT_NETWORK "<default>"
+
+struct alignas(64) network_t {
+  i16_t feature_weights[nnue_inputs][nnue_hidden];
+  i16_t feature_bias[nnue_hidden];
+  i16_t output_weights[2 * nnue_hidden];
+  i16_t output_bias;
+};
+
+// define the network and whether the evaluation uses it
+network_t _network;
+std::string _network_name = "none";
+bool use_nnue = false;
+
+// get the input of a piece on a square as seen from a perspective
+constexpr int feature_index(color_t perspective, piece_t piece, square_t square) {
+  int relative_color = color(piece) != perspective;
+  square_t relative_square = perspective == white ? square : square ^ 56;
+  return (relative_color * 6 + (piece_type(piece) >> 2) - 1) * 64 + relative_square;
+};
+
+// add a weight vector to an accumulator
+void _add_weights(i16_t* accumulator, const i16_t* weights) {
+#if defined(__AVX2__)
+  for (int index = 0; index < nnue_hidden; index += 16) {
+    __m256i values = _mm256_load_si256((__m256i*)(accumulator + index));
+    values = _mm256_add_epi16(values, _mm256_load_si256((const __m256i*)(weights + index)));
+    _mm256_store_si256((__m256i*)(accumulator + index), values);
+  };
+#elif defined(__SSE2__)
+  for (int index = 0; index < nnue_hidden; index += 8) {
+    __m128i values = _mm_load_si128((__m128i*)(accumulator + index));
+    values = _mm_add_epi16(values, _mm_load_si128((const __m128i*)(weights + index)));
+    _mm_store_si128((__m128i*)(accumulator + index), values);
+  };
+#else
+  for (int index = 0; index < nnue_hidden; index++)
+    accumulator[index] += weights[index];
+#endif
+};
+
+// subtract a weight vector from an accumulator
+void _subtract_weights(i16_t* accumulator, const i16_t* weights) {
+#if defined(__AVX2__)
+  for (int index = 0; index < nnue_hidden; index += 16) {
+    __m256i values = _mm256_load_si256((__m256i*)(accumulator + index));
+    values = _mm256_sub_epi16(values, _mm256_load_si256((const __m256i*)(weights + index)));
+    _mm256_store_si256((__m256i*)(accumulator + index), values);
+  };
+#elif defined(__SSE2__)
+  for (int index = 0; index < nnue_hidden; index += 8) {
+    __m128i values = _mm_load_si128((__m128i*)(accumulator + index));
+    values = _mm_sub_epi16(values, _mm_load_si128((const __m128i*)(weights + index)));
+    _mm_store_si128((__m128i*)(accumulator + index), values);
+  };
+#else
+  for (int index = 0; index < nnue_hidden; index++)
+    accumulator[index] -= weights[index];
+#endif
+};
+
+// get the dot product of a clipped accumulator with the output weights
+i32_t _clipped_dot(const i16_t* accumulator, const i16_t* weights) {
+#if defined(__AVX2__)
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i clip = _mm256_set1_epi16(nnue_clip);
+  __m256i sum = _mm256_setzero_si256();
+  for (int index = 0; index < nnue_hidden; index += 16) {
+    __m256i values = _mm256_load_si256((const __m256i*)(accumulator + index));
+    values = _mm256_min_epi16(_mm256_max_epi16(values, zero), clip);
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(values, _mm256_load_si256((const __m256i*)(weights + index))));
+  };
+  __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0b01001110));
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0b10110001));
+  return _mm_cvtsi128_si32(half);
+#elif defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i clip = _mm_set1_epi16(nnue_clip);
+  __m128i sum = _mm_setzero_si128();
+  for (int index = 0; index < nnue_hidden; index += 8) {
+    __m128i values = _mm_load_si128((const __m128i*)(accumulator + index));
+    values = _mm_min_epi16(_mm_max_epi16(values, zero), clip);
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(values, _mm_load_si128((const __m128i*)(weights + index))));
+  };
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0b01001110));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0b10110001));
+  return _mm_cvtsi128_si32(sum);
+#else
+  i32_t sum = 0;
+  for (int index = 0; index < nnue_hidden; index++)
+    sum += std::clamp<i32_t>(accumulator[index], 0, nnue_clip) * weights[index];
+  return sum;
+#endif
+};
+
+struct alignas(64) accumulator_t {
+  i16_t values[2][nnue_hidden];
+
+  // get the accumulator of a perspective
+  i16_t* operator[](color_t perspective) {
+    return this->values[perspective >> 1];
+  };
+
+  // reset both perspectives to the feature biases
+  void reset() {
+    std::copy(_network.feature_bias, _network.feature_bias + nnue_hidden, this->values[0]);
+    std::copy(_network.feature_bias, _network.feature_bias + nnue_hidden, this->values[1]);
+  };
+
+  // add a piece on a square
+  void add(piece_t piece, square_t square) {
+    _add_weights((*this)[white], _network.feature_weights[feature_index(white, piece, square)]);
+    _add_weights((*this)[black], _network.feature_weights[feature_index(black, piece, square)]);
+  };
+
+  // remove a piece from a square
+  void remove(piece_t piece, square_t square) {
+    _subtract_weights((*this)[white], _network.feature_weights[feature_index(white, piece, square)]);
+    _subtract_weights((*this)[black], _network.feature_weights[feature_index(black, piece, square)]);
+  };
+};
+
+// get the network output of a position from the view of the side to move
+template <color_t color>
+i32_t nnue_output(accumulator_t& accumulator) {
+  constexpr color_t opponent = opponent(color);
+  i32_t output = (
+    _clipped_dot(accumulator[color], _network.output_weights) +
+    _clipped_dot(accumulator[opponent], _network.output_weights + nnue_hidden) +
+    _network.output_bias
+  );
+  return output * nnue_scale / (nnue_clip * nnue_output_quantization);
+};
+
+// generate the default network
+void load_default_network() {
+  constexpr std::array<const score_t*, 6> values = {
+    pawn_value_middlegame, knight_value_middlegame, bishop_value_middlegame,
+    rook_value_middlegame, queen_value_middlegame, king_value_middlegame,
+  };
+  u64_t state = ZOBRIST_SEED;
+  for (int feature = 0; feature < nnue_inputs; feature++) {
+    int relative_color = feature / 384;
+    int piece = (feature / 64) % 6;
+    int square = feature % 64;
+    _network.feature_weights[feature][0] = relative_color ? 0 : values[piece][square] / _default_psq_divisor;
+    for (int neuron = 1; neuron < nnue_hidden; neuron++)
+      _network.feature_weights[feature][neuron] = (i16_t)(splitmix64(state) % 33) - 16;
+  };
+  std::fill(_network.feature_bias, _network.feature_bias + nnue_hidden, 0);
+  std::fill(_network.output_weights, _network.output_weights + 2 * nnue_hidden, 0);
+  _network.output_weights[0] = _default_psq_divisor * nnue_clip * nnue_output_quantization / nnue_scale;
+  _network.output_weights[nnue_hidden] = -_network.output_weights[0];
+  _network.output_bias = 0;
+  _network_name = NNUE_DEFAULT_NETWORK;
+};
+
+// load the default network at startup
+const bool _network_initialized = (load_default_network(), true);
+
+// read little endian int16 values from a stream
+bool _read_values(std::ifstream& file, i16_t* values, int count) {
+  for (int index = 0; index < count; index++) {
+    unsigned char bytes[2];
+    if (!file.read((char*)bytes, 2))
+      return false;
+    values[index] = (i16_t)(bytes[0] | (bytes[1] << 8));
+  };
+  return true;
+};
+
+// load a network file, the current network is kept if the file is not valid
+bool load_network(std::string path) {
+  if (path.empty() || path == NNUE_DEFAULT_NETWORK) {
+    load_default_network();
+    return true;
+  };
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  constexpr std::streamoff expected_size = 2 * (nnue_inputs * nnue_hidden + nnue_hidden + 2 * nnue_hidden + 1);
+  if (!file.is_open() || file.tellg() != expected_size)
+    return false;
+  file.seekg(0);
+  network_t* network = new network_t;
+  bool valid = (
+    _read_values(file, &network->feature_weights[0][0], nnue_inputs * nnue_hidden) &&
+    _read_values(file, network->feature_bias, nnue_hidden) &&
+    _read_values(file, network->output_weights, 2 * nnue_hidden) &&
+    _read_values(file, &network->output_bias, 1)
+  );
+  if (valid) {
+    _network = *network;
+    _network_name = path;
+  };
+  delete network;
+  return valid;
+};
+
+// get the name of the loaded network
+std::string network_name() {
+  return _network_name;
+};
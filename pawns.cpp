@@ -0,0 +1,133 @@
+#pragma once
+
+#include <array>
+#include "attack.cpp"
+#include "base.cpp"
+#include "board.cpp"
+#include "psqt.cpp"
+
+/***********************************************************************
+ *
+ * Module for the pawn structure evaluation.
+ *
+ * Doubled, isolated and passed pawns and the pawn shield of the kings
+ * only depend on the pawns and kings, so their packed score is cached
+ * in a small per-thread table keyed by the pawn hash of the board.
+ * The entries store the full key and the passed pawns of both colors,
+ * which the evaluation reuses for terms that depend on other pieces.
+ *
+***********************************************************************/
+
+constexpr int pawn_table_size = 1 << 14;
+constexpr packed_score_t doubled_pawn_penalty = pack(-10, -20);
+constexpr packed_score_t isolated_pawn_penalty = pack(-10, -15);
+constexpr packed_score_t king_shield_bonus[2] = {pack(10, 0), pack(5, 0)};
+constexpr packed_score_t unblocked_passed_pawn_bonus = pack(0, 10);
+constexpr packed_score_t passed_pawn_bonus[8] = {
+  pack(0, 0), pack(5, 10), pack(10, 20), pack(15, 35), pack(25, 60), pack(40, 90), pack(60, 130), pack(0, 0),
+};
+
+struct pawn_masks_t {
+  std::array<bitboard_t, 8> adjacent_files{0ULL};
+  std::array<std::array<bitboard_t, 64>, 4> forward_file{};
+  std::array<std::array<bitboard_t, 64>, 4> passed{};
+};
+
+// generate the pawn structure masks at compile time
+constexpr pawn_masks_t _generate_pawn_masks() {
+  pawn_masks_t masks;
+  for (int file = 0; file < 8; file++)
+    masks.adjacent_files[file] = ((files[file] << 1) & ~file_a) | ((files[file] >> 1) & ~file_h);
+  for (square_t square = 0; square < 64; square++) {
+    bitboard_t above = (1ULL << (8 * (square / 8))) - 1;
+    bitboard_t below = square / 8 == 7 ? none : ~((1ULL << (8 * (square / 8 + 1))) - 1);
+    bitboard_t file = files[square % 8];
+    bitboard_t file_span = file | masks.adjacent_files[square % 8];
+    masks.forward_file[white][square] = file & above;
+    masks.forward_file[black][square] = file & below;
+    masks.passed[white][square] = file_span & above;
+    masks.passed[black][square] = file_span & below;
+  };
+  return masks;
+};
+constexpr pawn_masks_t pawn_masks = _generate_pawn_masks();
+
+// get the rank of a square as seen from a color, starting at 0
+template <color_t color>
+constexpr int relative_rank(square_t square) {
+  if constexpr (color == white)
+    return 7 - square / 8;
+  else
+    return square / 8;
+};
+
+// evaluate the pawn structure of a color and collect its passed pawns
+template <color_t color>
+packed_score_t _evaluate_pawns(Board& board, bitboard_t& passed_pawns) {
+  constexpr color_t opponent = opponent(color);
+  constexpr piece_t color_pawn = to_color(pawn, color);
+  constexpr piece_t color_king = to_color(king, color);
+  constexpr piece_t opponent_pawn = to_color(pawn, opponent);
+  bitboard_t color_pawns = board.bitboards[color_pawn];
+  bitboard_t opponent_pawns = board.bitboards[opponent_pawn];
+  packed_score_t score = 0;
+  bitboard_t pawns = color_pawns;
+  while (pawns) {
+    square_t square = pop_lsb(pawns);
+    if (pawn_masks.forward_file[color][square] & color_pawns)
+      score += doubled_pawn_penalty;
+    if (!(pawn_masks.adjacent_files[square % 8] & color_pawns))
+      score += isolated_pawn_penalty;
+    if (!(pawn_masks.passed[color][square] & opponent_pawns)) {
+      set_bit(passed_pawns, square);
+      score += passed_pawn_bonus[relative_rank<color>(square)];
+    };
+  };
+  // count the pawns on the two ranks in front of the king
+  bitboard_t king = board.bitboards[color_king];
+  bitboard_t shield = multi_pawn_attack<color>(king) | (color == white ? king >> 8 : king << 8);
+  score += popcount(shield & color_pawns) * king_shield_bonus[0];
+  shield = color == white ? shield >> 8 : shield << 8;
+  score += popcount(shield & color_pawns) * king_shield_bonus[1];
+  return score;
+};
+
+struct pawn_entry_t {
+  hash_t key;
+  bitboard_t passed_pawns;
+  packed_score_t score;
+};
+
+struct pawn_table_t {
+  std::array<pawn_entry_t, pawn_table_size> entries;
+  u64_t hits;
+  u64_t misses;
+
+  // get the entry of the pawn structure of a board, evaluate it if it is not stored
+  pawn_entry_t& probe(Board& board) {
+    hash_t key = board.zobrist.pawn_hash;
+    pawn_entry_t& entry = this->entries[key & (pawn_table_size - 1)];
+    if (entry.key == key) {
+      ++this->hits;
+      return entry;
+    };
+    ++this->misses;
+    entry.key = key;
+    entry.passed_pawns = none;
+    entry.score = _evaluate_pawns<white>(board, entry.passed_pawns) - _evaluate_pawns<black>(board, entry.passed_pawns);
+    return entry;
+  };
+
+  // reset the hit counters
+  void reset_counters() {
+    this->hits = 0;
+    this->misses = 0;
+  };
+};
+
+// evaluate the passed pawns that can advance, from white's point of view
+packed_score_t unblocked_passed_pawns(Board& board, bitboard_t passed_pawns) {
+  bitboard_t white_passed_pawns = passed_pawns & board.bitboards[white_pawn] & ~(board.bitboards[none] << 8);
+  bitboard_t black_passed_pawns = passed_pawns & board.bitboards[black_pawn] & ~(board.bitboards[none] >> 8);
+  return (popcount(white_passed_pawns) - popcount(black_passed_pawns)) * unblocked_passed_pawn_bonus;
+};
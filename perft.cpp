@@ -1,15 +1,28 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <thread>
+#include <vector>
 #include "modules/time.cpp"
 #include "movegen/movegen.cpp"
 #include "base.cpp"
 #include "board.cpp"
+#include "perfthash.cpp"
 
 /**********************************************************************
  * 
  * Module for perft testing.
  * 
+ * With more than one thread the subtrees below the first two plies
+ * are handed out to the workers one by one, so the work stays balanced
+ * even if the root moves lead to subtrees of very different size.
+ * Each worker walks its subtrees on its own copy of the board.
+ * 
+ * A hashed perft stores the node counts of the subtrees in the perft
+ * hash table, so transpositions are only counted once.
+ * 
 **********************************************************************/
 
 struct perft_result_t {
@@ -24,37 +37,87 @@ u64_t _perft(Board& board, int depth) {
   constexpr color_t opponent = opponent(color);
   if (depth == 0) return 1;
   if (depth == 1) return generate<color, movetype, u64_t>(board);
+  u64_t nodes = 0;
+  if (perft_table_enabled() && probe_perft_table(board.zobrist.hash, depth, movetype, nodes))
+    return nodes;
+  move_stack_t legal_moves = generate<color, legal, move_stack_t>(board);
   if (depth == 2) {
-    move_stack_t legal_moves = generate<color, legal, move_stack_t>(board);
-    u64_t nodes = 0;
     for (move_t move : legal_moves) {
       board.make<color>(move);
       nodes += generate<opponent, movetype, u64_t>(board);
       board.unmake<color>();
     };
-    return nodes;
+  } else {
+    for (move_t move : legal_moves) {
+      board.make<color>(move);
+      nodes += _perft<opponent, movetype>(board, depth - 1);
+      board.unmake<color>();
+    };
   };
-  move_stack_t legal_moves = generate<color, legal, move_stack_t>(board);
-  u64_t nodes = 0;
-  for (move_t move : legal_moves) {
-    board.make<color>(move);
-    nodes += _perft<opponent, movetype>(board, depth - 1);
+  if (perft_table_enabled())
+    store_perft_table(board.zobrist.hash, depth, movetype, nodes);
+  return nodes;
+};
+
+struct _perft_task_t {
+  int root_index;
+  move_t root_move;
+  move_t reply;
+};
+
+// count the nodes below every root move, split over multiple threads, needs a depth of at least 3
+template<color_t color, movetype_t movetype=legal>
+std::vector<u64_t> _split_perft(Board& board, move_stack_t& root_moves, int depth, int threads) {
+  constexpr color_t opponent = opponent(color);
+  // collect the positions after the first two plies as tasks
+  std::vector<_perft_task_t> tasks;
+  for (int index = 0; index < root_moves.size(); index++) {
+    board.make<color>(root_moves[index]);
+    move_stack_t replies = generate<opponent, legal, move_stack_t>(board);
+    for (move_t reply : replies)
+      tasks.push_back(_perft_task_t{ index, root_moves[index], reply });
     board.unmake<color>();
   };
-  return nodes;
+  std::vector<std::atomic<u64_t>> root_nodes(root_moves.size());
+  std::atomic<u64_t> next_task(0);
+  auto worker = [&]() {
+    Board worker_board = board;
+    u64_t task_index;
+    while ((task_index = next_task.fetch_add(1, std::memory_order_relaxed)) < tasks.size()) {
+      _perft_task_t& task = tasks[task_index];
+      worker_board.make<color>(task.root_move);
+      worker_board.make<opponent>(task.reply);
+      u64_t nodes = _perft<color, movetype>(worker_board, depth - 2);
+      worker_board.unmake<opponent>();
+      worker_board.unmake<color>();
+      root_nodes[task.root_index].fetch_add(nodes, std::memory_order_relaxed);
+    };
+  };
+  std::vector<std::thread> workers;
+  for (int id = 0; id < threads; id++)
+    workers.emplace_back(worker);
+  for (std::thread& thread : workers)
+    thread.join();
+  return std::vector<u64_t>(root_nodes.begin(), root_nodes.end());
 };
 
 // perft function with printing
 template<color_t color, movetype_t movetype=legal>
-perft_result_t _perft(Board& board, int depth, bool print) {
+perft_result_t _perft(Board& board, int depth, bool print, int threads=1) {
   constexpr color_t opponent = opponent(color);
   u64_t start_time = nanoseconds();
   u64_t nodes = 0;
   move_stack_t legal_moves = generate<color, legal, move_stack_t>(board);
   move_stack_t moves = generate<color, movetype, move_stack_t>(board);
-  for (move_t move : legal_moves) {
+  std::vector<u64_t> root_nodes;
+  if (threads > 1 && depth >= 3)
+    root_nodes = _split_perft<color, movetype>(board, legal_moves, depth, threads);
+  for (int index = 0; index < legal_moves.size(); index++) {
+    move_t move = legal_moves[index];
     u64_t local_nodes = 0;
-    if (moves.contains(move) || depth != 1) {
+    if (!root_nodes.empty()) {
+      local_nodes = root_nodes[index];
+    } else if (moves.contains(move) || depth != 1) {
       board.make<color>(move);
       local_nodes = _perft<opponent, movetype>(board, depth - 1);
       board.unmake<color>();
@@ -77,11 +140,12 @@ perft_result_t _perft(Board& board, int depth, bool print) {
 
 // wrapper function for perft
 template<movetype_t movetype=legal>
-perft_result_t perft(Board& board, int depth, bool print=true) {
+perft_result_t perft(Board& board, int depth, bool print=true, int threads=1) {
   if (depth == 0) return perft_result_t{ 0, 0, 0 };
+  threads = std::clamp(threads, 1, MAX_THREADS);
   if (board.turn == white) {
-    return _perft<white, movetype>(board, depth, print);
+    return _perft<white, movetype>(board, depth, print, threads);
   } else {
-    return _perft<black, movetype>(board, depth, print);
+    return _perft<black, movetype>(board, depth, print, threads);
   };
-};
\ No newline at end of file
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include "base.cpp"
+
+/***********************************************************************
+ *
+ * Module to handle the perft hash table.
+ *
+ * The table maps a position and a remaining depth to the exact number
+ * of leaf nodes below it. It is separate from the transposition table
+ * of the search and only allocated for the duration of a hashed perft.
+ *
+ * An entry holds the full 64 bit key and a data word with the node
+ * count, the movetype counted at the leaves and the depth, so a key
+ * collision can never return a wrong count. The key is stored xored
+ * with the data, an entry torn by two threads writing at the same time
+ * then fails the key comparison instead of returning a mixed count.
+ *
+***********************************************************************/
+
+constexpr int _perft_nodes_shift = 16;
+constexpr int _perft_movetype_shift = 8;
+constexpr u64_t _perft_depth_mask = 0xFF;
+constexpr u64_t _perft_movetype_mask = 0xFF00;
+
+struct perft_entry_t {
+  std::atomic<u64_t> key_data;
+  std::atomic<u64_t> data;
+};
+
+// define the perft hash table
+u64_t _perft_table_size = 0;
+u64_t _perft_index_mask = 0;
+perft_entry_t* _perft_table = nullptr;
+
+// allocate a cleared perft hash table of the given MiB, 0 frees the table, halve the size until the
+// allocation succeeds and run without a table if even the smallest one does not fit, return if the full size was allocated
+bool resize_perft_table(u64_t mib) {
+  delete[] _perft_table;
+  _perft_table = nullptr;
+  _perft_table_size = 0;
+  _perft_index_mask = 0;
+  if (mib == 0)
+    return true;
+  mib = std::min<u64_t>(mib, MAX_HASH_SIZE);
+  u64_t requested_size = 1ULL << (63 - __builtin_clzll((mib << 20) / sizeof(perft_entry_t)));
+  u64_t size = requested_size;
+  for (; size >= (1ULL << 20) / sizeof(perft_entry_t); size >>= 1) {
+    _perft_table = new (std::nothrow) perft_entry_t[size];
+    if (_perft_table != nullptr)
+      break;
+  };
+  if (_perft_table == nullptr)
+    return false;
+  _perft_table_size = size;
+  _perft_index_mask = _perft_table_size - 1;
+  for (u64_t index = 0; index < _perft_table_size; index++) {
+    _perft_table[index].key_data.store(0, std::memory_order_relaxed);
+    _perft_table[index].data.store(0, std::memory_order_relaxed);
+  };
+  return size == requested_size;
+};
+
+// check if perft uses the hash table
+bool perft_table_enabled() {
+  return _perft_table != nullptr;
+};
+
+// look up the node count of a position at a depth, return if it was found
+bool probe_perft_table(hash_t hash, int depth, movetype_t movetype, u64_t& nodes) {
+  perft_entry_t& entry = _perft_table[hash & _perft_index_mask];
+  u64_t data = entry.data.load(std::memory_order_relaxed);
+  u64_t key = entry.key_data.load(std::memory_order_relaxed) ^ data;
+  if (
+    key != hash ||
+    (data & _perft_depth_mask) != (u64_t)depth ||
+    (data & _perft_movetype_mask) >> _perft_movetype_shift != movetype
+  )
+    return false;
+  nodes = data >> _perft_nodes_shift;
+  return true;
+};
+
+// store the node count of a position at a depth
+void store_perft_table(hash_t hash, int depth, movetype_t movetype, u64_t nodes) {
+  perft_entry_t& entry = _perft_table[hash & _perft_index_mask];
+  u64_t data = (nodes << _perft_nodes_shift) | ((u64_t)movetype << _perft_movetype_shift) | (u64_t)depth;
+  entry.key_data.store(hash ^ data, std::memory_order_relaxed);
+  entry.data.store(data, std::memory_order_relaxed);
+};
+
+// get the size of the perft hash table
+u64_t perft_table_size() {
+  return sizeof(perft_entry_t) * _perft_table_size;
+};
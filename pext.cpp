@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include "base.cpp"
+#include "magic.cpp"
+#ifdef USE_PEXT
+#include <immintrin.h>
+#endif
+
+/***********************************************************************
+ *
+ * Module to generate the pext table at compile time.
+ *
+ * With bmi2 the relevant occupancy of a sliding piece is compressed
+ * with pext into a dense index, so every square gets a table of exactly
+ * 2^n entries for its n relevant squares and the lookup needs no
+ * multiply. The table is only built when USE_PEXT is defined, else the
+ * magic table is used.
+ *
+***********************************************************************/
+
+#ifdef USE_PEXT
+
+constexpr int pext_table_size = 5248 + 102400;
+
+struct pext_t {
+  bitboard_t mask;
+  int offset;
+};
+
+// generate the pext masks and offsets of the bishops followed by the rooks
+constexpr std::array<std::array<pext_t, 64>, 2> _generate_pexts() {
+  std::array<std::array<pext_t, 64>, 2> pexts{};
+  int offset = 0;
+  for (square_t square = 0; square < none_square; ++square) {
+    pexts[0][square] = {incomplete_bishop_ray[square], offset};
+    offset += 1 << popcount(incomplete_bishop_ray[square]);
+  };
+  for (square_t square = 0; square < none_square; ++square) {
+    pexts[1][square] = {incomplete_rook_ray[square], offset};
+    offset += 1 << popcount(incomplete_rook_ray[square]);
+  };
+  return pexts;
+};
+constexpr std::array<std::array<pext_t, 64>, 2> _pexts = _generate_pexts();
+constexpr std::array<pext_t, 64> bishop_pexts = _pexts[0];
+constexpr std::array<pext_t, 64> rook_pexts = _pexts[1];
+
+// generate the pext table, the occupancy of an index is its pext inverse
+constexpr std::array<bitboard_t, pext_table_size> _generate_pext_table() {
+  std::array<bitboard_t, pext_table_size> pext_table{none};
+  for (square_t square = 0; square < none_square; ++square) {
+    bitboard_t bishop_ray = bishop_pexts[square].mask;
+    int occupancy_bound_bishop = 1 << popcount(bishop_ray);
+    for (int occupancy_index = 0; occupancy_index < occupancy_bound_bishop; occupancy_index++)
+      pext_table[bishop_pexts[square].offset + occupancy_index] =
+        _bishop_attacks(square, _generate_occupancy(occupancy_index, bishop_ray));
+    bitboard_t rook_ray = rook_pexts[square].mask;
+    int occupancy_bound_rook = 1 << popcount(rook_ray);
+    for (int occupancy_index = 0; occupancy_index < occupancy_bound_rook; occupancy_index++)
+      pext_table[rook_pexts[square].offset + occupancy_index] =
+        _rook_attacks(square, _generate_occupancy(occupancy_index, rook_ray));
+  };
+  return pext_table;
+};
+constexpr std::array<bitboard_t, pext_table_size> pext_table = _generate_pext_table();
+
+#endif
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include "base.cpp"
+
+/***********************************************************************
+ * 
+ * Module for the piece-square tables.
+ * 
+ * The tables are given from white's point of view, black pieces use
+ * the mirrored square. Every piece has a middlegame and an endgame
+ * value, both are packed into one 32 bit integer so that the board can
+ * keep their sums with a single addition. The board also keeps the
+ * game phase, from max_phase with all pieces down to 0 with only
+ * pawns and kings, which blends the two sums.
+ * 
+***********************************************************************/
+
+constexpr score_t pawn_value_middlegame[64] = {
+    0,   0,   0,   0,   0,   0,   0,   0,
+  150, 150, 150, 150, 150, 150, 150, 150,
+  110, 110, 120, 130, 130, 120, 110, 110,
+  105, 105, 110, 125, 125, 110, 105, 105,
+  100, 100, 100, 120, 120, 100, 100, 100,
+  105,  95,  90, 100, 100,  90,  95, 105,
+  105, 110, 110,  80,  80, 110, 110, 105,
+    0,   0,   0,   0,   0,   0,   0,   0,
+};
+
+constexpr score_t pawn_value_endgame[64] = {
+    0,   0,   0,   0,   0,   0,   0,   0,
+  220, 220, 220, 220, 220, 220, 220, 220,
+  160, 160, 160, 160, 160, 160, 160, 160,
+  130, 130, 130, 130, 130, 130, 130, 130,
+  115, 115, 115, 115, 115, 115, 115, 115,
+  105, 105, 105, 105, 105, 105, 105, 105,
+  100, 100, 100, 100, 100, 100, 100, 100,
+    0,   0,   0,   0,   0,   0,   0,   0,
+};
+
+constexpr score_t knight_value_middlegame[64] = {
+  300, 310, 320, 320, 320, 320, 310, 300,
+  310, 330, 350, 350, 350, 350, 330, 310,
+  320, 350, 360, 365, 365, 360, 350, 320,
+  320, 355, 365, 370, 370, 365, 355, 320,
+  320, 350, 365, 370, 370, 365, 350, 320,
+  320, 355, 360, 365, 365, 360, 355, 320,
+  310, 330, 350, 355, 355, 350, 330, 310,
+  300, 310, 320, 320, 320, 320, 310, 300,
+};
+
+constexpr score_t knight_value_endgame[64] = {
+  280, 290, 300, 300, 300, 300, 290, 280,
+  290, 305, 315, 320, 320, 315, 305, 290,
+  300, 315, 325, 330, 330, 325, 315, 300,
+  300, 320, 330, 335, 335, 330, 320, 300,
+  300, 320, 330, 335, 335, 330, 320, 300,
+  300, 315, 325, 330, 330, 325, 315, 300,
+  290, 305, 315, 320, 320, 315, 305, 290,
+  280, 290, 300, 300, 300, 300, 290, 280,
+};
+
+constexpr score_t bishop_value_middlegame[64] = {
+  330, 340, 340, 340, 340, 340, 340, 330,
+  340, 350, 350, 350, 350, 350, 350, 340,
+  340, 350, 355, 360, 360, 355, 350, 340,
+  340, 355, 355, 360, 360, 355, 355, 340,
+  340, 350, 360, 360, 360, 360, 350, 340,
+  340, 360, 360, 360, 360, 360, 360, 340,
+  340, 355, 350, 350, 350, 350, 355, 340,
+  330, 340, 340, 340, 340, 340, 340, 330,
+};
+
+constexpr score_t bishop_value_endgame[64] = {
+  340, 345, 345, 350, 350, 345, 345, 340,
+  345, 350, 355, 355, 355, 355, 350, 345,
+  345, 355, 360, 360, 360, 360, 355, 345,
+  350, 355, 360, 365, 365, 360, 355, 350,
+  350, 355, 360, 365, 365, 360, 355, 350,
+  345, 355, 360, 360, 360, 360, 355, 345,
+  345, 350, 355, 355, 355, 355, 350, 345,
+  340, 345, 345, 350, 350, 345, 345, 340,
+};
+
+constexpr score_t rook_value_middlegame[64] = {
+  525, 525, 525, 525, 525, 525, 525, 525,
+  530, 535, 535, 535, 535, 535, 535, 530,
+  520, 525, 525, 525, 525, 525, 525, 520,
+  520, 525, 525, 525, 525, 525, 525, 520,
+  520, 525, 525, 525, 525, 525, 525, 520,
+  520, 525, 525, 525, 525, 525, 525, 520,
+  520, 525, 525, 525, 525, 525, 525, 520,
+  525, 525, 525, 530, 530, 525, 525, 525,
+};
+
+constexpr score_t rook_value_endgame[64] = {
+  560, 560, 560, 560, 560, 560, 560, 560,
+  565, 565, 565, 565, 565, 565, 565, 565,
+  555, 555, 555, 555, 555, 555, 555, 555,
+  550, 550, 550, 550, 550, 550, 550, 550,
+  550, 550, 550, 550, 550, 550, 550, 550,
+  550, 550, 550, 550, 550, 550, 550, 550,
+  550, 550, 550, 550, 550, 550, 550, 550,
+  550, 550, 550, 550, 550, 550, 550, 550,
+};
+
+constexpr score_t queen_value_middlegame[64] = {
+   980,  990,  990,  995,  995,  990,  990,  980,
+   990, 1000, 1000, 1000, 1000, 1000, 1000,  990,
+   990, 1000, 1005, 1005, 1005, 1005, 1000,  990,
+   995, 1000, 1005, 1005, 1005, 1005, 1000,  995,
+  1000, 1000, 1005, 1005, 1005, 1005, 1000,  995,
+   990, 1005, 1005, 1005, 1005, 1005, 1000,  990,
+   990, 1000, 1005, 1000, 1000, 1000, 1000,  990,
+   980,  990,  990,  995,  995,  990,  990,  980,
+};
+
+constexpr score_t queen_value_endgame[64] = {
+   990, 1000, 1005, 1010, 1010, 1005, 1000,  990,
+  1000, 1010, 1015, 1020, 1020, 1015, 1010, 1000,
+  1005, 1015, 1020, 1025, 1025, 1020, 1015, 1005,
+  1010, 1020, 1025, 1030, 1030, 1025, 1020, 1010,
+  1010, 1020, 1025, 1030, 1030, 1025, 1020, 1010,
+  1005, 1015, 1020, 1025, 1025, 1020, 1015, 1005,
+  1000, 1010, 1015, 1020, 1020, 1015, 1010, 1000,
+   990, 1000, 1005, 1010, 1010, 1005, 1000,  990,
+};
+
+constexpr score_t king_value_middlegame[64] = {
+  -30, -40, -40, -50, -50, -40, -40, -30,
+  -30, -40, -40, -50, -50, -40, -40, -30,
+  -30, -40, -40, -50, -50, -40, -40, -30,
+  -30, -40, -40, -50, -50, -40, -40, -30,
+  -20, -30, -30, -40, -40, -30, -30, -20,
+  -10, -20, -20, -20, -20, -20, -20, -10,
+   20,  20,   0,   0,   0,   0,  20,  20,
+   20,  30,  10,   0,   0,  10,  30,  20,
+};
+
+constexpr score_t king_value_endgame[64] = {
+  -50, -40, -30, -20, -20, -30, -40, -50,
+  -30, -20, -10,   0,   0, -10, -20, -30,
+  -30, -10,  20,  30,  30,  20, -10, -30,
+  -30, -10,  30,  40,  40,  30, -10, -30,
+  -30, -10,  30,  40,  40,  30, -10, -30,
+  -30, -10,  20,  30,  30,  20, -10, -30,
+  -30, -30,   0,   0,   0,   0, -30, -30,
+  -50, -30, -30, -30, -30, -30, -30, -50,
+};
+
+// generate the phase weight of each piece at compile time, pawns and kings do not count
+constexpr u8_t max_phase = 24;
+constexpr std::array<u8_t, 32> _generate_phase_weight() {
+  std::array<u8_t, 32> phase_weight{0};
+  phase_weight[white_knight] = phase_weight[black_knight] = 1;
+  phase_weight[white_bishop] = phase_weight[black_bishop] = 1;
+  phase_weight[white_rook] = phase_weight[black_rook] = 2;
+  phase_weight[white_queen] = phase_weight[black_queen] = 4;
+  return phase_weight;
+};
+constexpr std::array<u8_t, 32> phase_weight = _generate_phase_weight();
+
+// generate the material value of each piece at compile time, used to order and judge exchanges
+constexpr std::array<score_t, 32> _generate_piece_value() {
+  constexpr score_t type_value[8] = {0, 100, 320, 330, 500, 950, 20000, 0};
+  std::array<score_t, 32> piece_value{0};
+  for (piece_t piece = 0; piece < 32; piece++)
+    piece_value[piece] = type_value[piece_type(piece) >> 2];
+  return piece_value;
+};
+constexpr std::array<score_t, 32> piece_value = _generate_piece_value();
+
+// pack a middlegame and an endgame score into one integer
+constexpr packed_score_t pack(score_t middlegame, score_t endgame) {
+  return (packed_score_t)((u32_t)endgame << 16) + middlegame;
+};
+
+// get the middlegame score of a packed score
+constexpr score_t middlegame(packed_score_t packed_score) {
+  return (score_t)(u16_t)(u32_t)packed_score;
+};
+
+// get the endgame score of a packed score, the carry of a negative middlegame score is undone
+constexpr score_t endgame(packed_score_t packed_score) {
+  return (score_t)(u16_t)((u32_t)(packed_score + 0x8000) >> 16);
+};
+
+// blend a packed score by the game phase
+constexpr score_t taper(packed_score_t packed_score, u8_t phase) {
+  phase = std::min(phase, max_phase);
+  return (middlegame(packed_score) * phase + endgame(packed_score) * (max_phase - phase)) / max_phase;
+};
+
+// generate the packed piece-square table at compile time, black pieces count negative
+constexpr std::array<std::array<packed_score_t, 64>, 32> _generate_psq_table() {
+  std::array<std::array<packed_score_t, 64>, 32> psq_table{};
+  for (square_t square = 0; square < 64; square++) {
+    psq_table[white_pawn][square] = pack(pawn_value_middlegame[square], pawn_value_endgame[square]);
+    psq_table[white_knight][square] = pack(knight_value_middlegame[square], knight_value_endgame[square]);
+    psq_table[white_bishop][square] = pack(bishop_value_middlegame[square], bishop_value_endgame[square]);
+    psq_table[white_rook][square] = pack(rook_value_middlegame[square], rook_value_endgame[square]);
+    psq_table[white_queen][square] = pack(queen_value_middlegame[square], queen_value_endgame[square]);
+    psq_table[white_king][square] = pack(king_value_middlegame[square], king_value_endgame[square]);
+  };
+  for (square_t square = 0; square < 64; square++) {
+    psq_table[black_pawn][square] = -psq_table[white_pawn][square ^ 56];
+    psq_table[black_knight][square] = -psq_table[white_knight][square ^ 56];
+    psq_table[black_bishop][square] = -psq_table[white_bishop][square ^ 56];
+    psq_table[black_rook][square] = -psq_table[white_rook][square ^ 56];
+    psq_table[black_queen][square] = -psq_table[white_queen][square ^ 56];
+    psq_table[black_king][square] = -psq_table[white_king][square ^ 56];
+  };
+  return psq_table;
+};
+constexpr std::array<std::array<packed_score_t, 64>, 32> psq_table = _generate_psq_table();
@@ -1,16 +1,38 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <sstream>
+#include <thread>
+#include <utility>
+#include <vector>
 #include "modules/time.cpp"
+#include "movegen/movegen.cpp"
 #include "base.cpp"
 #include "board.cpp"
+#include "evalcache.cpp"
 #include "evaluation.cpp"
+#include "history.cpp"
+#include "movepicker.cpp"
+#include "see.cpp"
+#include "timeman.cpp"
 #include "transposition.cpp"
 
 /***********************************************************************
- * 
+ *
  * Module for the search algorithm.
- * 
+ *
+ * The search is a Lazy SMP search: all threads search the same root
+ * position and only communicate through the transposition table.
+ * Helper threads skip some depths to diversify the search.
+ *
+ * The search runs asynchronously on its own thread, so the UCI loop
+ * stays responsive and can stop it at any node. The main thread checks
+ * the time limits and stops all threads once they are exceeded.
+ *
 ***********************************************************************/
 
 struct search_result_t {
@@ -18,17 +40,194 @@ struct search_result_t {
   score_t score;
 };
 
+// state of a single search thread
+struct search_thread_t {
+  int id;
+  Board board;
+  std::atomic<u64_t> nodes;
+  std::atomic<u64_t> tbhits;
+  int completed_depth;
+  int time_check_countdown;
+  bool follow_pv;
+  move_t pv_table[MAX_PV_DEPTH + 1][MAX_PV_DEPTH + 1];
+  pawn_table_t pawn_table;
+  history_t history;
+  u64_t eval_cache_hits;
+  u64_t eval_cache_misses;
+  int pv_length[MAX_PV_DEPTH + 1];
+  search_result_t result;
+
+  // count a searched node, only the owning thread writes the counters
+  void count_node() {
+    this->nodes.store(this->nodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  };
+
+  // set the pv of a ply to a move, optionally followed by the pv of the next ply
+  void update_pv(int ply, move_t move, bool append_child) {
+    this->pv_table[ply][0] = move;
+    this->pv_length[ply] = 1;
+    if (!append_child)
+      return;
+    for (int index = 0; index < this->pv_length[ply + 1]; index++)
+      this->pv_table[ply][index + 1] = this->pv_table[ply + 1][index];
+    this->pv_length[ply] += this->pv_length[ply + 1];
+  };
+
+  // count a transposition table hit
+  void count_tbhit() {
+    this->tbhits.store(this->tbhits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  };
+};
+
+// define the search threads
+std::vector<search_thread_t*> _search_threads = {new search_thread_t {}};
+std::atomic<bool> _stop_search(false);
+std::atomic<bool> _pondering(false);
+std::atomic<bool> _infinite(false);
+std::thread _main_search_thread;
+
+// number of search calls between two checks of the clock
+constexpr int time_check_interval = 1024;
+
+// minimum depth for null move pruning, deeper nodes reduce the null move search more
+constexpr int null_move_min_depth = 3;
+constexpr int null_move_reduction = 2;
+constexpr int null_move_depth_divisor = 4;
+
+// late move reductions start after the first moves of a node at some depth
+constexpr int lmr_min_depth = 3;
+constexpr int lmr_min_moves = 3;
+constexpr int lmr_max_moves = 64;
+
+// generate the late move reductions by depth and move number at startup, std::log is not constexpr everywhere
+std::array<std::array<u8_t, lmr_max_moves>, MAX_PV_DEPTH + 1> _generate_reductions() {
+  std::array<std::array<u8_t, lmr_max_moves>, MAX_PV_DEPTH + 1> reductions{};
+  for (int depth = 1; depth <= MAX_PV_DEPTH; depth++)
+    for (int move_count = 1; move_count < lmr_max_moves; move_count++)
+      reductions[depth][move_count] = 0.75 + std::log(depth) * std::log(move_count) / 2.25;
+  return reductions;
+};
+const std::array<std::array<u8_t, lmr_max_moves>, MAX_PV_DEPTH + 1> reductions = _generate_reductions();
+
+// aspiration windows start at some depth with a window of a few centipawns around the last score,
+// they are set by the Aspiration option and off by default as their gain is within the noise
+bool use_aspiration = false;
+constexpr int aspiration_min_depth = 4;
+constexpr int aspiration_delta = 30;
+
+// depth skipping pattern of the helper threads
+constexpr int _skip_size[20] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+constexpr int _skip_phase[20] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
+// set the number of search threads
+void set_threads(int threads) {
+  threads = std::clamp(threads, 1, MAX_THREADS);
+  while ((int)_search_threads.size() < threads)
+    _search_threads.push_back(new search_thread_t {});
+  while ((int)_search_threads.size() > threads) {
+    delete _search_threads.back();
+    _search_threads.pop_back();
+  };
+};
+
+// get the number of search threads
+int thread_count() {
+  return _search_threads.size();
+};
+
+// get the combined node count of all threads
+u64_t total_nodes() {
+  u64_t nodes = 0;
+  for (search_thread_t* thread : _search_threads)
+    nodes += thread->nodes.load(std::memory_order_relaxed);
+  return nodes;
+};
+
+// get the combined transposition table hits of all threads
+u64_t total_tbhits() {
+  u64_t tbhits = 0;
+  for (search_thread_t* thread : _search_threads)
+    tbhits += thread->tbhits.load(std::memory_order_relaxed);
+  return tbhits;
+};
+
+// get the combined pawn table hits and misses of all threads
+std::pair<u64_t, u64_t> pawn_table_counters() {
+  u64_t hits = 0;
+  u64_t misses = 0;
+  for (search_thread_t* thread : _search_threads) {
+    hits += thread->pawn_table.hits;
+    misses += thread->pawn_table.misses;
+  };
+  return {hits, misses};
+};
+
+// get the combined evaluation cache hits and misses of all threads
+std::pair<u64_t, u64_t> eval_cache_counters() {
+  u64_t hits = 0;
+  u64_t misses = 0;
+  for (search_thread_t* thread : _search_threads) {
+    hits += thread->eval_cache_hits;
+    misses += thread->eval_cache_misses;
+  };
+  return {hits, misses};
+};
+
+// clear the move ordering history of all threads
+void clear_history() {
+  for (search_thread_t* thread : _search_threads)
+    thread->history.clear();
+};
+
+// check if the search should stop
+bool search_stopped() {
+  return _stop_search.load(std::memory_order_relaxed);
+};
+
+// check the hard time limit every few calls on the main thread
+void check_time(search_thread_t& thread) {
+  if (thread.id != 0 || --thread.time_check_countdown > 0)
+    return;
+  thread.time_check_countdown = time_check_interval;
+  if (!_pondering && hard_limit_reached())
+    _stop_search = true;
+};
+
+// evaluate a board, reuse the score if the position is in the evaluation cache
+template <color_t color>
+score_t cached_evaluate(Board& board, search_thread_t& thread) {
+  if (!eval_cache_enabled())
+    return evaluate<color>(board, thread.pawn_table);
+  score_t score;
+  if (probe_eval_cache(board.zobrist.hash, score)) {
+    ++thread.eval_cache_hits;
+    return score;
+  };
+  ++thread.eval_cache_misses;
+  score = evaluate<color>(board, thread.pawn_table);
+  store_eval_cache(board.zobrist.hash, score);
+  return score;
+};
+
 // do quiescence search
 template <color_t color>
-score_t q_search(Board& board, int depth, score_t alpha, score_t beta, u64_t& nodes) {
+score_t q_search(Board& board, int depth, score_t alpha, score_t beta, search_thread_t& thread) {
   constexpr color_t opponent = opponent(color);
+  check_time(thread);
+  if (search_stopped())
+    return draw;
   if (depth == 0) {
-    nodes++;
-    return evaluate<color>(board);
+    thread.count_node();
+    return cached_evaluate<color>(board, thread);
   };
-  score_t score = evaluate<color>(board);
+  // only positions in check are tested for mate, stalemate is left to the search
+  if (is_check<color>(board) && generate<color, legal, u64_t>(board) == 0) {
+    thread.count_node();
+    return -checkmate;
+  };
+  score_t score = cached_evaluate<color>(board, thread);
   if (score >= beta) {
-    nodes++;
+    thread.count_node();
     return beta;
   };
   if (alpha < score)
@@ -36,8 +235,13 @@ score_t q_search(Board& board, int depth, score_t alpha, score_t beta, u64_t& no
   move_stack_t moves = generate<color, check | capture, move_stack_t>(board);
   moves.sort(comparison);
   for (move_t move : moves) {
+    // skip captures that lose material, checks are always searched
+    if (!check(move) && see<color>(board, move) < 0)
+      continue;
+    if (eval_cache_enabled())
+      prefetch_eval_cache(board.key_after<color>(move));
     board.make<color>(move);
-    score = add_depth(q_search<opponent>(board, depth - 1, remove_depth(beta), remove_depth(alpha), nodes));
+    score = add_depth(q_search<opponent>(board, depth - 1, remove_depth(beta), remove_depth(alpha), thread));
     board.unmake<color>();
     if (score >= beta)
       return beta;
@@ -49,92 +253,297 @@ score_t q_search(Board& board, int depth, score_t alpha, score_t beta, u64_t& no
 
 // do search optimized for current color
 template <color_t color>
-search_result_t search(Board board, int depth, score_t alpha, score_t beta, pv_t old_pv, u64_t& tbhits, u64_t& nodes) {
+score_t search(Board& board, int depth, int ply, score_t alpha, score_t beta, search_thread_t& thread) {
   constexpr color_t opponent = opponent(color);
-  if (depth == 0)
-    return search_result_t {pv_t {}, q_search<color>(board, MAX_QSEARCH_DEPTH, alpha, beta, nodes)};
+  thread.pv_length[ply] = 0;
+  check_time(thread);
+  if (search_stopped())
+    return draw;
+  if (depth == 0 || ply >= MAX_PV_DEPTH)
+    return q_search<color>(board, MAX_QSEARCH_DEPTH, alpha, beta, thread);
   if (board.position_existed()) {
-    ++nodes;
-    return search_result_t {pv_t {}, draw};
+    thread.count_node();
+    return draw;
   };
-  pv_t pv {};
   entry_t& entry = get_entry(board.zobrist.hash);
-  if (entry.is_valid(board.zobrist.hash, depth)) {
-    tbhits++;
+  // never cut at the root, so that the search always returns a full pv
+  if (ply > 0 && entry.is_valid(board.zobrist.hash, depth)) {
+    thread.count_tbhit();
     u8_t bound = entry.get_bound();
     score_t entry_score = entry.get_score();
     if (bound == exact_bound) {
-      pv.push(entry.move);
-      ++nodes;
-      return search_result_t {pv, entry_score};
+      // the key is only partly validated, a colliding entry must not put an illegal move into the pv
+      if (is_valid<color>(board, entry.move))
+        thread.update_pv(ply, entry.move, false);
+      thread.count_node();
+      return entry_score;
     } else if (bound == upper_bound && beta > entry_score) {
       beta = entry_score;
     } else if (bound == lower_bound && alpha < entry_score) {
       alpha = entry_score;
     };
     if (alpha >= beta) {
-      ++nodes;
-      return search_result_t {pv, entry_score};
+      thread.count_node();
+      return entry_score;
+    };
+  };
+  // null move pruning, if passing the turn still holds beta a real move will most likely too
+  // never two null moves in a row, in check or when only pawns are left and zugzwang is likely
+  bool in_check = is_check<color>(board);
+  if (
+    ply > 0 && !thread.follow_pv && !in_check && depth >= null_move_min_depth &&
+    previous_move(board) != none && has_non_pawn_material<color>(board) &&
+    cached_evaluate<color>(board, thread) >= beta
+  ) {
+    int reduction = null_move_reduction + depth / null_move_depth_divisor;
+    board.make_null<color>();
+    score_t score = add_depth(search<opponent>(board, std::max(depth - 1 - reduction, 0), ply + 1, remove_depth(beta), remove_depth(beta - 1), thread));
+    board.unmake_null<color>();
+    if (search_stopped())
+      return alpha;
+    if (score >= beta)
+      return beta;
+  };
+  // search the move of the previous iteration's pv first while on the pv
+  move_t pv_move = none;
+  if (thread.follow_pv) {
+    pv_move = ply < thread.result.pv.size() ? thread.result.pv[ply] : none;
+    if (!is_valid<color>(board, pv_move)) {
+      pv_move = none;
+      thread.follow_pv = false;
     };
   };
-  move_stack_t legal_moves = generate<color, legal, move_stack_t>(board);
-  legal_moves.sort(reverse_comparison);
-  if (old_pv.size() > 0) {
-    move_t move = old_pv.pop();
-    if (legal_moves.contains(move, reverse_comparison))
-      legal_moves.push(move);
-    else
-      old_pv.clear();
-  };
-  if (legal_moves.contains(entry.move, reverse_comparison))
-    legal_moves.push(entry.move);
-  legal_moves.reverse();
+  MovePicker<color> move_picker(board, thread.history, ply, pv_move, entry.move);
   u8_t bound = upper_bound;
-  for (move_t move : legal_moves) {
+  move_t best_move = none;
+  int move_count = 0;
+  move_stack_t searched_quiets;
+  move_t move;
+  while ((move = move_picker.next()) != none) {
+    ++move_count;
+    if (depth > 1)
+      prefetch_entry(board.key_after<color>(move));
     board.make<color>(move);
-    search_result_t search_result = search<opponent>(board, depth - 1, remove_depth(beta), remove_depth(alpha), old_pv, tbhits, nodes);
+    score_t score;
+    if (move_count == 1) {
+      score = add_depth(search<opponent>(board, depth - 1, ply + 1, remove_depth(beta), remove_depth(alpha), thread));
+    } else {
+      // reduce late quiet moves, they are unlikely to raise alpha
+      int reduction = 0;
+      if (depth >= lmr_min_depth && move_count > lmr_min_moves && !in_check && !check(move) && !capture(move))
+        reduction = std::min<int>(reductions[depth][std::min(move_count, lmr_max_moves - 1)], depth - 2);
+      // prove with a null window that the move does not raise alpha, search it again if it does
+      score = add_depth(search<opponent>(board, depth - 1 - reduction, ply + 1, remove_depth(alpha + 1), remove_depth(alpha), thread));
+      if (score > alpha && reduction > 0)
+        score = add_depth(search<opponent>(board, depth - 1, ply + 1, remove_depth(alpha + 1), remove_depth(alpha), thread));
+      if (score > alpha && score < beta)
+        score = add_depth(search<opponent>(board, depth - 1, ply + 1, remove_depth(beta), remove_depth(alpha), thread));
+    };
     board.unmake<color>();
-    search_result.score = add_depth(search_result.score);
-    if (search_result.score > alpha) {
-      pv = search_result.pv.copy();
-      pv.push(move);
-      if (search_result.score >= beta) {
-        entry.set(board.zobrist.hash, move, search_result.score, depth, lower_bound);
-        return search_result_t {pv, beta};
+    thread.follow_pv = false;
+    if (search_stopped())
+      return alpha;
+    if (score > alpha) {
+      thread.update_pv(ply, move, true);
+      if (score >= beta) {
+        if (!capture(move))
+          thread.history.update(color, ply, depth, move, previous_move(board), searched_quiets);
+        entry.set(board.zobrist.hash, move, score, depth, lower_bound);
+        return beta;
       };
-      alpha = search_result.score;
+      alpha = score;
+      best_move = move;
       bound = exact_bound;
     };
+    if (!capture(move))
+      searched_quiets.push(move);
+  };
+  if (move_count == 0) {
+    thread.count_node();
+    return in_check ? -checkmate : draw;
+  };
+  entry.set(board.zobrist.hash, best_move, alpha, depth, bound);
+  return alpha;
+};
+
+// do iterative deepening on a single thread
+void iterative_deepening(search_thread_t& thread, int max_depth) {
+  u64_t start_time = milliseconds();
+  for (int i = 1; i <= max_depth; i++) {
+    // helper threads skip some depths so that the threads spread over different depths
+    if (thread.id > 0) {
+      int index = (thread.id - 1) % 20;
+      if (((i + _skip_phase[index]) / _skip_size[index]) % 2)
+        continue;
+    };
+    // search a window around the score of the previous iteration, unless it is a mate score
+    int delta = aspiration_delta;
+    int alpha = -inf;
+    int beta = inf;
+    score_t previous_score = thread.board.turn == white ? thread.result.score : -thread.result.score;
+    if (use_aspiration && i >= aspiration_min_depth && thread.completed_depth > 0 && std::abs(previous_score) < max_eval) {
+      alpha = std::max<int>(previous_score - delta, -inf);
+      beta = std::min<int>(previous_score + delta, inf);
+    };
+    score_t score;
+    while (true) {
+      thread.follow_pv = true;
+      if (thread.board.turn == white)
+        score = search<white>(thread.board, i, 0, alpha, beta, thread);
+      else
+        score = search<black>(thread.board, i, 0, alpha, beta, thread);
+      if (search_stopped() || (score > alpha && score < beta))
+        break;
+      // report the bound, the printed score is from white's point of view
+      if (thread.id == 0) {
+        bool white_lowerbound = (score >= beta) == (thread.board.turn == white);
+        u64_t end_time = milliseconds();
+        u64_t nodes = total_nodes();
+        std::ostringstream info;
+        info << "info depth " << i
+             << " score cp " << (thread.board.turn == white ? score : -score)
+             << (white_lowerbound ? " lowerbound" : " upperbound")
+             << " time " << end_time - start_time
+             << " nodes " << nodes
+             << " nps " << nodes * 1000 / std::max<u64_t>(end_time - start_time, 1) << "\n";
+        std::cout << info.str() << std::flush;
+      };
+      // widen the window exponentially on the side the score fell out of
+      if (score <= alpha)
+        alpha = std::max<int>(alpha - delta, -inf);
+      else
+        beta = std::min<int>(beta + delta, inf);
+      delta *= 2;
+    };
+    if (thread.board.turn == black)
+      score = -score;
+    if (search_stopped())
+      break;
+    thread.result.score = score;
+    thread.result.pv.clear();
+    for (int index = 0; index < thread.pv_length[0]; index++)
+      thread.result.pv.push(thread.pv_table[0][index]);
+    thread.completed_depth = i;
+    if (thread.id > 0)
+      continue;
+    u64_t end_time = milliseconds();
+    u64_t nodes = total_nodes();
+    u64_t nps = nodes * 1000 / std::max<u64_t>(end_time - start_time, 1);
+    std::ostringstream info;
+    info << "info depth " << i
+         << " score cp " << thread.result.score
+         << " time " << end_time - start_time
+         << " tbhits " << total_tbhits()
+         << " nodes " << nodes
+         << " nps " << nps
+         << " hashfull " << hashfull()
+         << " string current bestmove " << move_to_string(thread.result.pv[0]) << "\n";
+    std::cout << info.str() << std::flush;
+    // do not start an iteration that will most likely not finish in time
+    if (!_pondering && soft_limit_reached())
+      break;
+  };
+};
+
+// prepare the search threads for a new search
+void prepare_search(Board& board, search_limits_t& limits) {
+  _stop_search = false;
+  _pondering = limits.ponder;
+  _infinite = limits.infinite;
+  init_time(limits, board.turn);
+  new_search_generation();
+  for (int id = 0; id < thread_count(); id++) {
+    search_thread_t& thread = *_search_threads[id];
+    thread.id = id;
+    thread.board = board;
+    if (use_nnue)
+      thread.board.refresh_accumulator();
+    thread.nodes = 0;
+    thread.tbhits = 0;
+    thread.pawn_table.reset_counters();
+    thread.eval_cache_hits = 0;
+    thread.eval_cache_misses = 0;
+    thread.history.clear_killers();
+    thread.completed_depth = 0;
+    thread.result.pv.clear();
+    thread.time_check_countdown = time_check_interval;
   };
-  entry.set(board.zobrist.hash, pv[0], alpha, depth, bound);
-  return search_result_t {pv, alpha};
+};
+
+// run the search on the prepared threads
+search_result_t run_search(int depth) {
+  // start the helper threads, they search until the main thread is done
+  std::vector<std::thread> helpers;
+  for (int id = 1; id < thread_count(); id++)
+    helpers.emplace_back(iterative_deepening, std::ref(*_search_threads[id]), MAX_PV_DEPTH);
+  iterative_deepening(*_search_threads[0], depth);
+  // the result may not be reported before stop or ponderhit
+  while ((_pondering || _infinite) && !search_stopped())
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  _stop_search = true;
+  for (std::thread& helper : helpers)
+    helper.join();
+  // prefer the result of a helper thread that completed a deeper search
+  search_thread_t* best_thread = _search_threads[0];
+  for (search_thread_t* thread : _search_threads)
+    if (thread->completed_depth > best_thread->completed_depth)
+      best_thread = thread;
+  return best_thread->result;
 };
 
 // do search
 search_result_t search(Board& board, int depth) {
-  search_result_t search_result;
-  pv_t pv {};
-  for (int i = 1; i <= depth; i++) {
-    u64_t tbhits = 0;
-    u64_t nodes = 0;
-    u64_t start_time = milliseconds();
-    if (board.turn == white) {
-      search_result = search<white>(board, i, -inf, inf, pv, tbhits, nodes);
-    } else {
-      search_result = search<black>(board, i, -inf, inf, pv, tbhits, nodes);
-      search_result.score = -search_result.score;
+  search_limits_t limits;
+  prepare_search(board, limits);
+  return run_search(depth);
+};
+
+// get the best move of a search result, fall back to any legal move
+move_t best_move(Board& board, search_result_t& search_result) {
+  if (search_result.pv.size() > 0)
+    return search_result.pv[0];
+  move_stack_t legal_moves = board.turn == white ?
+    generate<white, legal, move_stack_t>(board) :
+    generate<black, legal, move_stack_t>(board);
+  return legal_moves.empty() ? none : legal_moves[0];
+};
+
+// stop a running search and wait for it to report
+void stop_search() {
+  _stop_search = true;
+  if (_main_search_thread.joinable())
+    _main_search_thread.join();
+};
+
+// switch from pondering to normal search
+void ponderhit() {
+  restart_time();
+  _pondering = false;
+};
+
+// start the search in the background and report the best move when done
+void start_search(Board& board, search_limits_t& limits) {
+  stop_search();
+  prepare_search(board, limits);
+  int depth = limits.depth;
+  _main_search_thread = std::thread([depth]() {
+    search_thread_t& thread = *_search_threads[0];
+    search_result_t search_result = run_search(depth);
+    std::ostringstream output;
+    auto [pawn_hits, pawn_misses] = pawn_table_counters();
+    output << "info string pawn table hits " << pawn_hits
+           << " misses " << pawn_misses
+           << " hitrate " << pawn_hits * 100 / std::max<u64_t>(pawn_hits + pawn_misses, 1) << "%\n";
+    if (eval_cache_enabled()) {
+      auto [eval_hits, eval_misses] = eval_cache_counters();
+      output << "info string eval cache hits " << eval_hits
+             << " misses " << eval_misses
+             << " hitrate " << eval_hits * 100 / std::max<u64_t>(eval_hits + eval_misses, 1) << "%\n";
     };
-    u64_t end_time = milliseconds();
-    pv = search_result.pv.copy();
-    search_result.pv.reverse();
-    u64_t nps = nodes / ((end_time - start_time) / 1000.0);
-    std::cout << "info depth " << i
-              << " score cp " << search_result.score
-              << " time " << end_time - start_time
-              << " tbhits " << tbhits
-              << " nodes " << nodes
-              << " nps " << nps
-              << " string current bestmove " << move_to_string(search_result.pv[0]) << "\n";
-  };
-  return search_result;
-};
\ No newline at end of file
+    output << "bestmove " << move_to_string(best_move(thread.board, search_result));
+    if (search_result.pv.size() > 1)
+      output << " ponder " << move_to_string(search_result.pv[1]);
+    output << "\n";
+    std::cout << output.str() << std::flush;
+  });
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include "attack.cpp"
+#include "base.cpp"
+#include "board.cpp"
+#include "psqt.cpp"
+
+/***********************************************************************
+ *
+ * Module for the static exchange evaluation.
+ *
+ * The static exchange evaluation plays out all captures on the target
+ * square of a move, each side always recapturing with its least
+ * valuable attacker, and returns the material balance for the side to
+ * move when both sides may stop capturing whenever it suits them.
+ *
+ * Removing an attacker from the occupancy uncovers the sliders behind
+ * it, which are added through the magic attacks (x-rays). Pins are not
+ * considered, a king only captures when the square is not defended.
+ *
+***********************************************************************/
+
+// get all the attacks on a square through a given occupancy
+bitboard_t _see_attackers(Board& board, square_t square, bitboard_t occupancy) {
+  return occupancy & (
+    (attack<black_pawn>(square) & board.bitboards[white_pawn]) |
+    (attack<white_pawn>(square) & board.bitboards[black_pawn]) |
+    (attack<knight>(square) & board.bitboards[knight]) |
+    (attack<bishop>(square, occupancy) & (board.bitboards[bishop] | board.bitboards[queen])) |
+    (attack<rook>(square, occupancy) & (board.bitboards[rook] | board.bitboards[queen])) |
+    (attack<king>(square) & board.bitboards[king])
+  );
+};
+
+// get the static exchange evaluation of a move
+template <color_t color>
+score_t see(Board& board, move_t move) {
+  constexpr std::array<piece_t, 6> piece_types = {pawn, knight, bishop, rook, queen, king};
+  square_t from = from(move);
+  square_t to = to(move);
+  std::array<score_t, 32> gain;
+  int depth = 0;
+  bitboard_t occupancy = board.bitboards[none] ^ bitboard(from);
+  if (enpassant(move)) {
+    gain[0] = piece_value[pawn];
+    occupancy ^= bitboard(color == white ? to + 8 : to - 8);
+  } else {
+    gain[0] = piece_value[board.pieces[to]];
+  };
+  // the piece standing on the square after the move
+  score_t on_square = piece_value[target_piece(move)];
+  if (promotion(move))
+    gain[0] += on_square - piece_value[pawn];
+  bitboard_t diagonal_sliders = board.bitboards[bishop] | board.bitboards[queen];
+  bitboard_t straight_sliders = board.bitboards[rook] | board.bitboards[queen];
+  bitboard_t attackers = _see_attackers(board, to, occupancy);
+  color_t side = opponent(color);
+  while (true) {
+    bitboard_t side_attackers = attackers & board.bitboards[side];
+    if (!side_attackers)
+      break;
+    // find the least valuable attacker
+    piece_t attacker = none;
+    bitboard_t attacker_bitboard = none;
+    for (piece_t piece_type : piece_types) {
+      attacker_bitboard = side_attackers & board.bitboards[piece_type];
+      if (attacker_bitboard) {
+        attacker = piece_type;
+        break;
+      };
+    };
+    // the king may not capture into a defended square
+    if (attacker == king && (attackers & board.bitboards[opponent(side)]))
+      break;
+    ++depth;
+    gain[depth] = on_square - gain[depth - 1];
+    on_square = piece_value[attacker];
+    occupancy ^= attacker_bitboard & -attacker_bitboard;
+    // uncover the sliders behind the attacker
+    if (attacker == pawn || attacker == bishop || attacker == queen)
+      attackers |= attack<bishop>(to, occupancy) & diagonal_sliders;
+    if (attacker == rook || attacker == queen)
+      attackers |= attack<rook>(to, occupancy) & straight_sliders;
+    attackers &= occupancy;
+    side = opponent(side);
+  };
+  // let each side stop capturing when it would lose material
+  while (depth > 0) {
+    gain[depth - 1] = -std::max<score_t>(-gain[depth - 1], gain[depth]);
+    --depth;
+  };
+  return gain[0];
+};
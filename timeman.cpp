@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include "modules/time.cpp"
+#include "base.cpp"
+
+/***********************************************************************
+ *
+ * Module for the time management.
+ *
+ * Turns the UCI clock parameters into a soft limit, after which no new
+ * iteration is started, and a hard limit, at which the search is
+ * aborted. All times are in milliseconds.
+ *
+***********************************************************************/
+
+constexpr u64_t move_overhead = 30;
+constexpr int default_moves_to_go = 30;
+constexpr int max_moves_to_go = 50;
+constexpr u64_t hard_limit_factor = 4;
+
+struct search_limits_t {
+  int depth = 0;
+  u64_t time[4] = {0, 0, 0, 0};
+  u64_t increment[4] = {0, 0, 0, 0};
+  int movestogo = 0;
+  u64_t movetime = 0;
+  bool infinite = false;
+  bool ponder = false;
+
+  // check if the search is limited by the clock
+  bool timed() {
+    return this->movetime || this->time[white] || this->time[black];
+  };
+};
+
+// define the current time limits, zero means no limit
+std::atomic<u64_t> _start_time(0);
+std::atomic<u64_t> _soft_limit(0);
+std::atomic<u64_t> _hard_limit(0);
+
+// set the time limits for a search of the given color
+void init_time(search_limits_t& limits, color_t color) {
+  _start_time = milliseconds();
+  _soft_limit = 0;
+  _hard_limit = 0;
+  if (limits.movetime) {
+    u64_t limit = std::max<u64_t>(limits.movetime - std::min(limits.movetime, move_overhead), 1);
+    _soft_limit = limit;
+    _hard_limit = limit;
+  } else if (limits.time[color]) {
+    u64_t time = limits.time[color];
+    u64_t increment = limits.increment[color];
+    u64_t moves_to_go = limits.movestogo ? std::min(limits.movestogo, max_moves_to_go) : default_moves_to_go;
+    // never plan to use more than the time left minus the overhead
+    u64_t available = std::max<u64_t>(time - std::min(time, move_overhead), 1);
+    u64_t soft_limit = time / moves_to_go + 3 * increment / 4;
+    u64_t hard_limit = std::min(hard_limit_factor * soft_limit, available / 2 + increment / 2);
+    _hard_limit = std::clamp<u64_t>(hard_limit, 1, available);
+    _soft_limit = std::clamp<u64_t>(soft_limit, 1, _hard_limit);
+  };
+};
+
+// restart the clock, e.g. when pondering turns into a normal search
+void restart_time() {
+  _start_time = milliseconds();
+};
+
+// get the elapsed time since the search started
+u64_t elapsed_time() {
+  return milliseconds() - _start_time;
+};
+
+// check if no new iteration should be started
+bool soft_limit_reached() {
+  return _soft_limit && elapsed_time() >= _soft_limit;
+};
+
+// check if the search has to be aborted
+bool hard_limit_reached() {
+  return _hard_limit && elapsed_time() >= _hard_limit;
+};
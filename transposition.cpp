@@ -1,12 +1,25 @@
 #pragma once
 
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
 #include "modules/system.cpp"
 #include "base.cpp"
 
 /***********************************************************************
- * 
+ *
  * Module to handle the transposition table.
- * 
+ *
+ * The table consists of cache line sized buckets with five entries
+ * each. Entries carry the generation of the search that wrote them,
+ * old and shallow entries are replaced first. The size is given in
+ * MiB and rounded down to a power of two number of buckets.
+ *
+ * The table is backed by huge pages when possible. It is first touched
+ * by the clearing threads, so on NUMA systems its pages are spread over
+ * the nodes of these threads.
+ *
 ***********************************************************************/
 
 constexpr u8_t exact_bound = 0;
@@ -14,27 +27,33 @@ constexpr u8_t lower_bound = 1;
 constexpr u8_t upper_bound = 2;
 constexpr u64_t _validation_mask = 0xFFFFFFFF00000000;
 constexpr u16_t _validation_shift = 32;
-constexpr u32_t _depth_mask = 0x000000FF;
-constexpr u32_t _depth_shift = 0;
-constexpr u32_t _score_mask = 0x00FFFF00;
-constexpr u32_t _score_shift = 8;
-constexpr u32_t _bound_mask = 0xFF000000;
-constexpr u32_t _bound_shift = 24;
+constexpr u8_t _bound_mask = 0b00000011;
+constexpr u8_t _generation_mask = 0b11111100;
+constexpr u8_t _generation_shift = 2;
+constexpr u8_t _generation_cycle = 64;
+constexpr int _age_weight = 8;
+constexpr int bucket_size = 5;
+
+// define the generation of the current search
+u8_t _generation = 0;
 
 struct entry_t {
   u32_t hash_validation;
   move_t move;
-  u32_t flags;
+  score_t score;
+  u8_t depth;
+  u8_t generation_bound;
 
   // set the entry
   void set(const hash_t& hash, const move_t& move, const score_t& score, const u8_t& depth, const u8_t& bound) {
-    this->hash_validation = (hash & _validation_mask) >> _validation_shift;
-    this->move = move;
-    this->flags = (
-      (depth << _depth_shift) |
-      (score << _score_shift) |
-      (bound << _bound_shift)
-    );
+    u32_t hash_validation = (hash & _validation_mask) >> _validation_shift;
+    // keep the move of the position if no new one is known
+    if (move != none || hash_validation != this->hash_validation)
+      this->move = move;
+    this->hash_validation = hash_validation;
+    this->score = score;
+    this->depth = depth;
+    this->generation_bound = (_generation << _generation_shift) | bound;
   };
 
   // get the move from the entry
@@ -44,39 +63,148 @@ struct entry_t {
 
   // get the depth from the entry
   u8_t get_depth() {
-    return (flags & _depth_mask) >> _depth_shift;
+    return this->depth;
   };
 
   // get the score from the entry
   score_t get_score() {
-    return (flags & _score_mask) >> _score_shift;
+    return this->score;
   };
 
   // get the bound from the entry
   u8_t get_bound() {
-    return (flags & _bound_mask) >> _bound_shift;
+    return this->generation_bound & _bound_mask;
+  };
+
+  // get the generation from the entry
+  u8_t get_generation() {
+    return (this->generation_bound & _generation_mask) >> _generation_shift;
+  };
+
+  // get the number of searches since the entry was written
+  u8_t get_age() {
+    return (_generation_cycle + _generation - this->get_generation()) % _generation_cycle;
+  };
+
+  // mark the entry as used by the current search
+  void refresh() {
+    this->generation_bound = (_generation << _generation_shift) | this->get_bound();
   };
 
   // check if the entry is valid
   bool is_valid(hash_t hash, u8_t depth) {
     return (
       ((hash & _validation_mask) >> _validation_shift == this->hash_validation) &&
-      (((flags & _depth_mask) >> _depth_shift) >= depth)
+      (this->depth >= depth)
     );
   };
 };
 
+struct alignas(64) bucket_t {
+  entry_t entries[bucket_size];
+  u32_t padding;
+};
+static_assert(sizeof(bucket_t) == 64, "a bucket has to fill exactly one cache line");
+
+// get the number of buckets that fit into the given MiB
+u64_t _table_buckets(u64_t mib) {
+  return 1ULL << (63 - __builtin_clzll(std::max<u64_t>((mib << 20) / sizeof(bucket_t), 1)));
+};
+
 // define the transposition table
-u64_t _transposition_table_size = 1ULL << (63 - __builtin_clzll(3 * (free_ram() / sizeof(entry_t)) / 4));
-const u64_t _index_mask = _transposition_table_size - 1;
-entry_t *table = new entry_t[_transposition_table_size];
+u64_t _transposition_table_size = 0;
+u64_t _index_mask = 0;
+u8_t _table_allocation = no_allocation;
+bucket_t *table = nullptr;
+
+// clear the transposition table, split over multiple threads
+void clear_table(int threads=1) {
+  threads = std::clamp<u64_t>(threads, 1, _transposition_table_size);
+  u64_t chunk_size = _transposition_table_size / threads;
+  std::vector<std::thread> workers;
+  for (int index = 0; index < threads; index++) {
+    u64_t start = index * chunk_size;
+    u64_t end = (index == threads - 1) ? _transposition_table_size : start + chunk_size;
+    workers.emplace_back([start, end]() {
+      std::memset((void*)(table + start), 0, (end - start) * sizeof(bucket_t));
+    });
+  };
+  for (std::thread& worker : workers)
+    worker.join();
+};
 
-// get the entry from the transposition table
+// resize the transposition table to the given MiB, halve the size until the allocation succeeds
+// and keep the old table if even the smallest one does not fit, return if the full size was allocated
+bool resize_table(u64_t mib, int threads=1) {
+  u64_t requested_size = _table_buckets(std::clamp<u64_t>(mib, 1, MAX_HASH_SIZE));
+  u64_t size = requested_size;
+  if (table != nullptr && size == _transposition_table_size) {
+    clear_table(threads);
+    return true;
+  };
+  u8_t allocation = no_allocation;
+  bucket_t* memory = nullptr;
+  for (; size >= _table_buckets(1); size >>= 1) {
+    memory = (bucket_t*)allocate_large(size * sizeof(bucket_t), allocation);
+    if (memory != nullptr)
+      break;
+  };
+  if (memory == nullptr)
+    return false;
+  free_large(table, _transposition_table_size * sizeof(bucket_t), _table_allocation);
+  table = memory;
+  _table_allocation = allocation;
+  _transposition_table_size = size;
+  _index_mask = _transposition_table_size - 1;
+  clear_table(threads);
+  return size == requested_size;
+};
+
+// allocate the default transposition table at startup
+const bool _table_initialized = (resize_table(DEFAULT_HASH_SIZE), true);
+
+// get how the transposition table memory was allocated
+std::string table_allocation() {
+  return allocation_to_string(_table_allocation);
+};
+
+// get the entry of a position, or the entry to replace if it is not stored
 entry_t& get_entry(hash_t hash) {
-  return table[hash & _index_mask];
+  bucket_t& bucket = table[hash & _index_mask];
+  u32_t hash_validation = (hash & _validation_mask) >> _validation_shift;
+  entry_t* replace = &bucket.entries[0];
+  for (entry_t& entry : bucket.entries) {
+    if (entry.hash_validation == hash_validation) {
+      entry.refresh();
+      return entry;
+    };
+    // prefer to replace shallow entries of old searches
+    if (entry.depth - _age_weight * entry.get_age() < replace->depth - _age_weight * replace->get_age())
+      replace = &entry;
+  };
+  return *replace;
+};
+
+// load the bucket of a position into the cache ahead of its probe
+void prefetch_entry(hash_t hash) {
+  __builtin_prefetch(&table[hash & _index_mask]);
+};
+
+// start a new search generation
+void new_search_generation() {
+  _generation = (_generation + 1) % _generation_cycle;
+};
+
+// estimate the permill of the table used by the current search
+int hashfull() {
+  int used = 0;
+  for (u64_t index = 0; index < 1000 / bucket_size; index++)
+    for (entry_t& entry : table[index].entries)
+      used += entry.depth && entry.get_generation() == _generation;
+  return used;
 };
 
 // get the size of the transposition table
 u64_t table_size() {
-  return sizeof(entry_t) * _transposition_table_size;
-};
\ No newline at end of file
+  return sizeof(bucket_t) * _transposition_table_size;
+};
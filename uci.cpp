@@ -1,12 +1,15 @@
 #pragma once
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include "modules/system.cpp"
 #include "base.cpp"
+#include "bench.cpp"
 #include "board.cpp"
 #include "debug.cpp"
+#include "evalcache.cpp"
 #include "perft.cpp"
 #include "search.cpp"
 #include "transposition.cpp"
@@ -17,31 +20,73 @@
  * 
 ***********************************************************************/
 
+// allocate the perft hash table of a run and report if it is smaller than asked for
+void _setup_perft_table(u64_t mib) {
+  if (resize_perft_table(mib))
+    return;
+  if (perft_table_enabled())
+    std::cout << "info string could not allocate " << mib << "MiB for the perft hash table, using "
+              << (perft_table_size() >> 20) << "MiB\n";
+  else
+    std::cout << "info string could not allocate a perft hash table, running without\n";
+};
+
 // uci go command
 void go(Board& board, std::istringstream& string_stream) {
   std::string token;
-  int depth = 8;
+  search_limits_t limits;
   while (string_stream >> token) {
     if (token == "perft") {
       int depth;
+      int threads = 1;
+      u64_t hash = 0;
       std::string movetype;
       string_stream >> depth;
-      string_stream >> movetype;
+      while (string_stream >> token) {
+        if (token == "threads")
+          string_stream >> threads;
+        else if (token == "hash")
+          string_stream >> hash;
+        else
+          movetype = token;
+      };
+      stop_search();
+      _setup_perft_table(hash);
       if (movetype == "quiet")
-        perft<quiet>(board, depth, true);
+        perft<quiet>(board, depth, true, threads);
       else if (movetype == "check")
-        perft<check>(board, depth, true);
+        perft<check>(board, depth, true, threads);
       else if (movetype == "capture")
-        perft<capture>(board, depth, true);
+        perft<capture>(board, depth, true, threads);
       else
-        perft<legal>(board, depth, true);
+        perft<legal>(board, depth, true, threads);
+      resize_perft_table(0);
       return;
     } else if (token == "depth") {
-      string_stream >> depth;
+      string_stream >> limits.depth;
+    } else if (token == "wtime") {
+      string_stream >> limits.time[white];
+    } else if (token == "btime") {
+      string_stream >> limits.time[black];
+    } else if (token == "winc") {
+      string_stream >> limits.increment[white];
+    } else if (token == "binc") {
+      string_stream >> limits.increment[black];
+    } else if (token == "movestogo") {
+      string_stream >> limits.movestogo;
+    } else if (token == "movetime") {
+      string_stream >> limits.movetime;
+    } else if (token == "ponder") {
+      limits.ponder = true;
+    } else if (token == "infinite") {
+      limits.infinite = true;
     };
   };
-  search_result_t search_result = search(board, depth);
-  std::cout << "bestmove " << move_to_string(search_result.pv[0]) << "\n";
+  // without any limit search to a fixed depth
+  if (limits.depth == 0)
+    limits.depth = (limits.timed() || limits.infinite) ? MAX_PV_DEPTH : 8;
+  limits.depth = std::min(limits.depth, MAX_PV_DEPTH);
+  start_search(board, limits);
 };
 
 // uci position command
@@ -63,23 +108,129 @@ void position(Board& board, std::istringstream& string_stream) {
   };
 };
 
+// parse the value of a spin option clamped to its bounds, return if it was a number
+template<typename T>
+bool _parse_spin(const std::string& value, T min, T max, T& result) {
+  std::istringstream string_stream(value);
+  long long parsed;
+  if (!(string_stream >> parsed))
+    return false;
+  result = (T)std::clamp<long long>(parsed, min, max);
+  return true;
+};
+
+// uci setoption command
+void set_option(std::istringstream& string_stream) {
+  std::string token, name, value;
+  string_stream >> token;
+  if (token != "name") return;
+  while (string_stream >> token && token != "value")
+    name += (name.empty() ? "" : " ") + token;
+  while (string_stream >> token)
+    value += (value.empty() ? "" : " ") + token;
+  if (name == "Threads") {
+    int threads;
+    if (!_parse_spin(value, 1, MAX_THREADS, threads)) {
+      std::cout << "info string invalid threads " << value << "\n";
+      return;
+    };
+    set_threads(threads);
+    std::cout << "info string threads " << thread_count() << "\n";
+  } else if (name == "Hash") {
+    u64_t mib;
+    if (!_parse_spin<u64_t>(value, 1, MAX_HASH_SIZE, mib)) {
+      std::cout << "info string invalid hash " << value << "\n";
+      return;
+    };
+    if (!resize_table(mib, thread_count()))
+      std::cout << "info string could not allocate " << mib << "MiB for the transposition table\n";
+    std::cout << "info string transposition table size " << (table_size() >> 20) << "MiB\n";
+    std::cout << "info string transposition table allocated with " << table_allocation() << "\n";
+  } else if (name == "Clear Hash") {
+    clear_table(thread_count());
+  } else if (name == "EvalCache") {
+    u64_t mib;
+    if (!_parse_spin<u64_t>(value, 0, MAX_EVAL_CACHE_SIZE, mib)) {
+      std::cout << "info string invalid eval cache size " << value << "\n";
+      return;
+    };
+    if (!resize_eval_cache(mib))
+      std::cout << "info string could not allocate " << mib << "MiB for the eval cache\n";
+    std::cout << "info string eval cache size " << (eval_cache_size() >> 20) << "MiB\n";
+  } else if (name == "Aspiration") {
+    use_aspiration = value == "true";
+    std::cout << "info string aspiration windows " << (use_aspiration ? "on" : "off") << "\n";
+  } else if (name == "Use NNUE") {
+    use_nnue = value == "true";
+    clear_eval_cache();
+    std::cout << "info string evaluation " << (use_nnue ? "nnue" : "classical") << "\n";
+  } else if (name == "EvalFile") {
+    if (load_network(value)) {
+      clear_eval_cache();
+      std::cout << "info string network " << network_name() << " loaded\n";
+    } else {
+      std::cout << "info string could not load network " << value << ", keeping " << network_name() << "\n";
+    };
+  };
+};
+
 // uci test command
 void test(Board& board, std::istringstream& string_stream) {
   std::string token;
   string_stream >> token;
   if (token == "perft") {
     std::string epd_file_path;
+    perft_suite_options_t options;
+    u64_t hash = 0;
     string_stream >> epd_file_path;
-    perft_test_suite(board, epd_file_path);
+    while (string_stream >> token) {
+      if (token == "threads")
+        string_stream >> options.threads;
+      else if (token == "depth")
+        string_stream >> options.max_depth;
+      else if (token == "time")
+        string_stream >> options.time_budget;
+      else if (token == "report")
+        string_stream >> options.report_path;
+      else if (token == "hash")
+        string_stream >> hash;
+    };
+    _setup_perft_table(hash);
+    perft_test_suite(epd_file_path, options);
+    resize_perft_table(0);
+  } else if (token == "eval") {
+    std::string epd_file_path = "perft.epd";
+    string_stream >> epd_file_path;
+    eval_benchmark(epd_file_path);
+  } else if (token == "see") {
+    std::string epd_file_path = "see.epd";
+    string_stream >> epd_file_path;
+    see_test_suite(board, epd_file_path);
   };
 };
 
+// uci bench command, missing or malformed arguments keep their defaults
+void bench(std::istringstream& string_stream) {
+  std::string token;
+  int depth = bench_default_depth;
+  int threads = bench_default_threads;
+  u64_t hash = bench_default_hash;
+  if (string_stream >> token)
+    _parse_spin(token, 1, MAX_PV_DEPTH, depth);
+  if (string_stream >> token)
+    _parse_spin(token, 1, MAX_THREADS, threads);
+  if (string_stream >> token)
+    _parse_spin<u64_t>(token, 1, MAX_HASH_SIZE, hash);
+  bench(depth, threads, hash);
+};
+
 // uci main loop
 void uci_loop() {
   std::cout << ENGINE_NAME << " v" << VERSION << " by " << AUTHOR << "\n";
   std::cout << "info string total ram " << (total_ram() >> 20) << "MiB\n";
   std::cout << "info string free ram " << (free_ram() >> 20) << "MiB\n";
   std::cout << "info string transposition table size " << (table_size() >> 20) << "MiB\n";
+  std::cout << "info string transposition table allocated with " << table_allocation() << "\n";
   Board board;
   std::string token, command;
   do {
@@ -91,20 +242,44 @@ void uci_loop() {
       std::cout << "id name " << ENGINE_NAME
                 << " v" << VERSION
                 << "\nid author " << AUTHOR
+                << "\noption name Threads type spin default 1 min 1 max " << MAX_THREADS
+                << "\noption name Hash type spin default " << DEFAULT_HASH_SIZE << " min 1 max " << MAX_HASH_SIZE
+                << "\noption name Clear Hash type button"
+                << "\noption name EvalCache type spin default " << DEFAULT_EVAL_CACHE_SIZE << " min 0 max " << MAX_EVAL_CACHE_SIZE
+                << "\noption name Aspiration type check default false"
+                << "\noption name Use NNUE type check default false"
+                << "\noption name EvalFile type string default " << NNUE_DEFAULT_NETWORK
                 << "\nuciok\n";
+    } else if (token == "ucinewgame") {
+      stop_search();
+      clear_table(thread_count());
+      clear_history();
     } else if (token == "isready") {
       std::cout << "readyok\n";
+    } else if (token == "stop") {
+      stop_search();
+    } else if (token == "ponderhit") {
+      ponderhit();
     } else if (token == "d") {
       print_board(board);
     } else if (token == "go") {
       go(board, string_stream);
+    } else if (token == "setoption") {
+      stop_search();
+      set_option(string_stream);
     } else if (token == "position") {
+      stop_search();
       position(board, string_stream);
     } else if (token == "stockfish") {
       std::cout << ASCII_ART << "\n";
       std::cout << "Arctic Foxes are the most beautiful animals in the world.\n";
     } else if (token == "test") {
+      stop_search();
       test(board, string_stream);
+    } else if (token == "bench") {
+      stop_search();
+      bench(string_stream);
     };
-  } while (token != "quit" && token != "exit");
+  } while (token != "quit" && token != "exit" && std::cin);
+  stop_search();
 };
\ No newline at end of file
@@ -5,65 +5,77 @@
 #include "base.cpp"
 
 /***********************************************************************
- * 
+ *
  * Module to generate and access everything zobrist hash related.
  *
+ * The keys are generated once at compile time and shared by all
+ * boards, a Zobrist object only holds the current hash and the pawn
+ * hash, which only covers the pawns and kings.
+ *
 ***********************************************************************/
 
-class Zobrist {
-private:
+struct zobrist_keys_t {
   std::array<std::array<hash_t, 64>, 32> piece_hash{0ULL};
   std::array<hash_t, 16> castling_hash{0ULL};
   std::array<hash_t, 65> enpassant_hash{0ULL};
   hash_t turn_hash = 0ULL;
+};
 
-public:
-  hash_t hash;
-
-  // initialize the tables with random values
-  Zobrist() {
-    seed(ZOBRIST_SEED);
-    for (square_t square = 0; square < 64; square++) {
-      for (piece_t piece = 0; piece < 32; piece++) {
-        this->piece_hash[piece][square] = random<hash_t>();
-      };
-    };
-    for (castling_t castling = 0; castling < 16; castling++) {
-      this->castling_hash[castling] = random<hash_t>();
+// generate the zobrist keys at compile time
+constexpr zobrist_keys_t _generate_zobrist_keys() {
+  zobrist_keys_t keys;
+  u64_t state = ZOBRIST_SEED;
+  for (square_t square = 0; square < 64; square++) {
+    for (piece_t piece = 0; piece < 32; piece++) {
+      keys.piece_hash[piece][square] = splitmix64(state);
     };
-    for (square_t square = 0; square < 64; square++) {
-      this->enpassant_hash[square] = random<hash_t>();
-    };
-    this->turn_hash = random<hash_t>();
   };
+  for (castling_t castling = 0; castling < 16; castling++) {
+    keys.castling_hash[castling] = splitmix64(state);
+  };
+  for (square_t square = 0; square < 64; square++) {
+    keys.enpassant_hash[square] = splitmix64(state);
+  };
+  keys.turn_hash = splitmix64(state);
+  return keys;
+};
+constexpr zobrist_keys_t zobrist_keys = _generate_zobrist_keys();
+
+class Zobrist {
+public:
+  hash_t hash;
+  hash_t pawn_hash;
 
   // update the hash with a piece change
   void update_piece(piece_t piece, square_t square) {
-    this->hash ^= this->piece_hash[piece][square];
+    this->hash ^= zobrist_keys.piece_hash[piece][square];
+    if (piece_type(piece) == pawn || piece_type(piece) == king)
+      this->pawn_hash ^= zobrist_keys.piece_hash[piece][square];
   };
 
   // update the hash with a castling change
   void update_castling(castling_t castling) {
-    this->hash ^= this->castling_hash[castling];
+    this->hash ^= zobrist_keys.castling_hash[castling];
   };
 
   // update the hash with a enpassant change
   void update_enpassant(square_t square) {
-    this->hash ^= this->enpassant_hash[square];
+    this->hash ^= zobrist_keys.enpassant_hash[square];
   };
 
   // update the hash with a turn change
   void update_turn() {
-    this->hash ^= this->turn_hash;
+    this->hash ^= zobrist_keys.turn_hash;
   };
 
   // clear the hash
   void clear() {
     this->hash = 0ULL;
+    this->pawn_hash = 0ULL;
   };
 
-  // set hash to a given value
+  // set hash to a given value, the pawn hash is restored by the piece changes
   void set(hash_t hash) {
     this->hash = hash;
   };
-};
\ No newline at end of file
+};